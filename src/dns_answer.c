@@ -0,0 +1,235 @@
+/**
+ * DNS Answer
+ * Contains implementation of answer sets with precompiled records for every
+ * slot of a weighted rotation. The schedule follows smooth weighted
+ * round-robin, which spreads the slots of each address evenly over the
+ * rotation instead of giving an address all of its slots in a row.
+*/
+
+#include <arpa/inet.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dns_answer.h"
+#include "dns_defns.h"
+
+void dns_answer_init(struct dns_answer_set *set)
+{
+    memset(set, 0, sizeof(*set));
+    set->a.record_size = DNS_ANSWER_A_SIZE;
+    set->aaaa.record_size = DNS_ANSWER_AAAA_SIZE;
+}
+
+bool dns_answer_add(struct dns_answer_set *set, const char *text)
+{
+    char address_text[INET6_ADDRSTRLEN];
+    unsigned long weight = 1;
+    const char *separator = strchr(text, '@');
+    size_t address_size = separator ? (size_t)(separator - text) : strlen(text);
+    if (address_size >= sizeof(address_text))
+    {
+        return false;
+    }
+    memcpy(address_text, text, address_size);
+    address_text[address_size] = '\0';
+    if (separator)
+    {
+        char *end;
+        weight = strtoul(separator + 1, &end, 10);
+        if (*end != '\0' || weight == 0 || weight > DNS_ANSWER_MAX_WEIGHT)
+        {
+            return false;
+        }
+    }
+
+    uint8_t address[sizeof(struct in6_addr)];
+    struct dns_answer_family *family;
+    if (inet_pton(AF_INET, address_text, address) == 1)
+    {
+        family = &set->a;
+    }
+    else if (inet_pton(AF_INET6, address_text, address) == 1)
+    {
+        family = &set->aaaa;
+    }
+    else
+    {
+        return false;
+    }
+    if (family->count == DNS_ANSWER_MAX_ADDRESSES)
+    {
+        return false;
+    }
+    memcpy(family->addresses[family->count], address, sizeof(address));
+    family->weights[family->count] = weight;
+    family->count++;
+    return true;
+}
+
+/**
+ * Write a single record with a compressed name pointing at the first question.
+ *
+ * record : Pointer to the record to write.
+ * type   : The record type, A or AAAA.
+ * family : The family the address belongs to.
+ * index  : The index of the address within the family.
+ */
+static void dns_answer_write_record(uint8_t *record, uint16_t type, const struct dns_answer_family *family, uint8_t index)
+{
+    uint16_t address_size = family->record_size - DNS_ANSWER_A_SIZE + sizeof(struct in_addr);
+    uint16_t fields[3] = {htons(0xC000 | DNS_HEADER_SIZE), htons(type), htons(DNS_RR_CLASS_IN)};
+    uint32_t ttl = htonl(DNS_TTL);
+    uint16_t rdlength = htons(address_size);
+    memcpy(record, fields, sizeof(fields));
+    memcpy(record + sizeof(fields), &ttl, sizeof(ttl));
+    memcpy(record + sizeof(fields) + sizeof(ttl), &rdlength, sizeof(rdlength));
+    memcpy(record + sizeof(fields) + sizeof(ttl) + sizeof(rdlength), family->addresses[index], address_size);
+}
+
+/**
+ * Build the rotation schedule of a family and compile the records of every
+ * slot. The address picked for a slot comes first, followed by the others in
+ * their usual cyclic order.
+ *
+ * family : Pointer to the family to compile.
+ * type   : The record type of the family.
+ */
+static void dns_answer_compile_family(struct dns_answer_family *family, uint16_t type)
+{
+    free(family->records);
+    family->records = NULL;
+    family->slot_count = 0;
+    if (family->count == 0)
+    {
+        return;
+    }
+
+    int total = 0;
+    for (uint8_t i = 0; i < family->count; i++)
+    {
+        total += family->weights[i];
+    }
+    family->slot_count = total;
+    size_t block_size = (size_t)family->count * family->record_size;
+    family->records = malloc(family->slot_count * block_size);
+    if (family->records == NULL)
+    {
+        err(1, "malloc");
+    }
+
+    int current[DNS_ANSWER_MAX_ADDRESSES] = {0};
+    for (uint16_t slot = 0; slot < family->slot_count; slot++)
+    {
+        uint8_t first = 0;
+        for (uint8_t i = 0; i < family->count; i++)
+        {
+            current[i] += family->weights[i];
+            if (current[i] > current[first])
+            {
+                first = i;
+            }
+        }
+        current[first] -= total;
+
+        uint8_t *block = family->records + slot * block_size;
+        for (uint8_t i = 0; i < family->count; i++)
+        {
+            dns_answer_write_record(block + i * family->record_size, type, family, (first + i) % family->count);
+        }
+    }
+}
+
+void dns_answer_compile(struct dns_answer_set *set)
+{
+    dns_answer_compile_family(&set->a, DNS_RR_TYPE_A);
+    dns_answer_compile_family(&set->aaaa, DNS_RR_TYPE_AAAA);
+}
+
+uint32_t dns_answer_period(const struct dns_answer_set *set)
+{
+    uint32_t a = set->a.slot_count ? set->a.slot_count : 1;
+    uint32_t aaaa = set->aaaa.slot_count ? set->aaaa.slot_count : 1;
+    uint32_t x = a, y = aaaa;
+    while (y != 0)
+    {
+        uint32_t remainder = x % y;
+        x = y;
+        y = remainder;
+    }
+    return a / x * aaaa;
+}
+
+void dns_answer_free(struct dns_answer_set *set)
+{
+    free(set->a.records);
+    free(set->aaaa.records);
+    set->a.records = NULL;
+    set->aaaa.records = NULL;
+}
+
+/**
+ * Copy the records of a family for the given rotation slot into the message.
+ * Returns the number of records copied.
+ */
+static int dns_answer_copy(const struct dns_answer_family *family, uint32_t rotation, uint16_t name_position, uint8_t *message, ssize_t *response_size)
+{
+    if (family->count == 0)
+    {
+        return 0;
+    }
+    size_t block_size = (size_t)family->count * family->record_size;
+    uint8_t *block = message + *response_size;
+    memcpy(block, family->records + (rotation % family->slot_count) * block_size, block_size);
+
+    // Records point at the first question unless told otherwise.
+    if (name_position != DNS_HEADER_SIZE)
+    {
+        uint16_t pointer = htons(0xC000 | name_position);
+        for (uint8_t i = 0; i < family->count; i++)
+        {
+            memcpy(block + i * family->record_size, &pointer, sizeof(pointer));
+        }
+    }
+    *response_size += block_size;
+    return family->count;
+}
+
+int dns_answer_append(const struct dns_answer_set *set, uint16_t question_type, uint32_t rotation, uint16_t name_position, uint8_t *message, ssize_t *response_size)
+{
+    bool answer_a = question_type == DNS_RR_TYPE_A || question_type == DNS_RR_TYPE_ANY;
+    bool answer_aaaa = question_type == DNS_RR_TYPE_AAAA || question_type == DNS_RR_TYPE_ANY;
+    size_t size = (answer_a ? set->a.count * set->a.record_size : 0) + (answer_aaaa ? set->aaaa.count * set->aaaa.record_size : 0);
+    if (*response_size + size > DNS_UDP_MAX_SIZE)
+    {
+        return -1;
+    }
+
+    int count = 0;
+    if (answer_a)
+    {
+        count += dns_answer_copy(&set->a, rotation, name_position, message, response_size);
+    }
+    if (answer_aaaa)
+    {
+        count += dns_answer_copy(&set->aaaa, rotation, name_position, message, response_size);
+    }
+    return count;
+}
+
+void dns_answer_print(const struct dns_answer_set *set, FILE *stream)
+{
+    char text[INET6_ADDRSTRLEN];
+    fprintf(stream, "answers:");
+    for (uint8_t i = 0; i < set->a.count; i++)
+    {
+        inet_ntop(AF_INET, set->a.addresses[i], text, sizeof(text));
+        fprintf(stream, " %s@%u", text, set->a.weights[i]);
+    }
+    for (uint8_t i = 0; i < set->aaaa.count; i++)
+    {
+        inet_ntop(AF_INET6, set->aaaa.addresses[i], text, sizeof(text));
+        fprintf(stream, " %s@%u", text, set->aaaa.weights[i]);
+    }
+    fprintf(stream, " slots=%u/%u\n", set->a.slot_count, set->aaaa.slot_count);
+}
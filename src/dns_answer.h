@@ -0,0 +1,119 @@
+/**
+ * Contains answer sets of several A and AAAA addresses, rotated per query so
+ * that sinkholed clients spread over a pool of backend servers. Each address
+ * has a weight, and a smooth weighted round-robin schedule decides which
+ * address comes first in each slot of the rotation (all weights equal gives
+ * plain round-robin). The answer records of every slot are compiled up front,
+ * so answering from a set is a copy of a precompiled block whichever slot the
+ * query falls in.
+ */
+#ifndef DNS_ANSWER_H
+#define DNS_ANSWER_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <netinet/in.h>
+#include <sys/types.h>
+
+// The maximum number of addresses of each family in a set.
+#define DNS_ANSWER_MAX_ADDRESSES 8
+
+// The maximum weight of an address, which bounds the rotation length.
+#define DNS_ANSWER_MAX_WEIGHT 16
+
+// The longest rotation, reached when every address has the maximum weight.
+#define DNS_ANSWER_MAX_SLOTS (DNS_ANSWER_MAX_ADDRESSES * DNS_ANSWER_MAX_WEIGHT)
+
+// The size of a single A and AAAA record with a compressed name, see RFC
+// 1035 4.1.3 and RFC 3596 2.2.
+#define DNS_ANSWER_A_SIZE 16
+#define DNS_ANSWER_AAAA_SIZE 28
+
+/**
+ * The addresses of one family, and their precompiled records for each slot
+ * of the rotation. Records point at the first question, and are patched when
+ * answering a later one.
+ */
+struct dns_answer_family
+{
+    uint8_t count;
+    uint8_t weights[DNS_ANSWER_MAX_ADDRESSES];
+    uint8_t addresses[DNS_ANSWER_MAX_ADDRESSES][sizeof(struct in6_addr)];
+    uint16_t slot_count;
+    uint16_t record_size;
+    uint8_t *records; // slot_count blocks of count records.
+};
+
+/**
+ * A set of addresses answered together.
+ */
+struct dns_answer_set
+{
+    struct dns_answer_family a;
+    struct dns_answer_family aaaa;
+};
+
+/**
+ * Reset the set to hold no addresses.
+ *
+ * set : Pointer to the set to initialize.
+ */
+void dns_answer_init(struct dns_answer_set *set);
+
+/**
+ * Add an address to the set, given as ADDRESS or ADDRESS@WEIGHT where the
+ * address is IPv4 or IPv6 and the weight defaults to one.
+ *
+ * set     : Pointer to the set to add to.
+ * text    : The address and optional weight.
+ * returns : True if the address was valid and the set had room for it.
+ */
+bool dns_answer_add(struct dns_answer_set *set, const char *text);
+
+/**
+ * Build the rotation schedule of each family and compile its records.
+ *
+ * set : Pointer to the set to compile, after all addresses are added.
+ */
+void dns_answer_compile(struct dns_answer_set *set);
+
+/**
+ * The number of distinct answers the set rotates through, after which both
+ * families are back at their first slot. Responses cached per rotation slot
+ * keep rotating when the cache is keyed by the rotation modulo this period.
+ *
+ * set     : Pointer to the compiled set.
+ * returns : The least common multiple of the slot counts of both families.
+ */
+uint32_t dns_answer_period(const struct dns_answer_set *set);
+
+/**
+ * Release the records compiled for the set.
+ *
+ * set : Pointer to the set to free.
+ */
+void dns_answer_free(struct dns_answer_set *set);
+
+/**
+ * Append the records answering a question to the message, in the order of
+ * the given rotation slot.
+ *
+ * set           : Pointer to the compiled set.
+ * question_type : The type of the question, A, AAAA or ANY.
+ * rotation      : The rotation counter of the query.
+ * name_position : The position of the question name, for name compression.
+ * message       : Pointer to the response being built.
+ * response_size : Pointer to the size of the response, updated.
+ * returns       : The number of records appended, or -1 if they do not fit.
+ */
+int dns_answer_append(const struct dns_answer_set *set, uint16_t question_type, uint32_t rotation, uint16_t name_position, uint8_t *message, ssize_t *response_size);
+
+/**
+ * Print the addresses and weights of the set.
+ *
+ * set    : Pointer to the set to print.
+ * stream : The stream to print to.
+ */
+void dns_answer_print(const struct dns_answer_set *set, FILE *stream);
+
+#endif // DNS_ANSWER_H
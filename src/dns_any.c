@@ -0,0 +1,146 @@
+/**
+ * DNS Any
+ * Contains implementation of the RFC 8482 replies to ANY queries.
+*/
+
+#include <arpa/inet.h>
+#include <string.h>
+
+#include "dns_any.h"
+#include "dns_defns.h"
+
+// The HINFO record answering the first question, with the TTL of every other
+// answer: a name pointer to offset 12, type, class, TTL, data length, then
+// the CPU and OS character strings.
+static const uint8_t dns_any_hinfo[DNS_ANY_HINFO_SIZE] = {
+    0xC0, DNS_HEADER_SIZE,
+    0x00, DNS_RR_TYPE_HINFO,
+    0x00, DNS_RR_CLASS_IN,
+    (DNS_TTL >> 24) & 0xFF, (DNS_TTL >> 16) & 0xFF, (DNS_TTL >> 8) & 0xFF, DNS_TTL & 0xFF,
+    0x00, 9,
+    7, 'R', 'F', 'C', '8', '4', '8', '2',
+    0};
+
+bool dns_any_parse_mode(const char *text, enum dns_any_mode *mode)
+{
+    if (strcmp(text, "answer") == 0)
+    {
+        *mode = DNS_ANY_ANSWER;
+    }
+    else if (strcmp(text, "hinfo") == 0)
+    {
+        *mode = DNS_ANY_HINFO;
+    }
+    else if (strcmp(text, "truncate") == 0)
+    {
+        *mode = DNS_ANY_TRUNCATE;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+void dns_any_append_hinfo(uint16_t name_position, uint8_t *message, ssize_t *response_size)
+{
+    uint8_t *record = message + *response_size;
+    memcpy(record, dns_any_hinfo, sizeof(dns_any_hinfo));
+    if (name_position != DNS_HEADER_SIZE)
+    {
+        uint16_t pointer = htons(0xC000 | name_position);
+        memcpy(record, &pointer, sizeof(pointer));
+    }
+    *response_size += sizeof(dns_any_hinfo);
+}
+
+/**
+ * Skip a name, which ends with a zero label or a compression pointer.
+ *
+ * message  : Pointer to the message.
+ * position : The position of the name.
+ * size     : The size of the message.
+ * returns  : The position after the name, past the end if it is cut short.
+ */
+static ssize_t dns_any_skip_name(const uint8_t *message, ssize_t position, ssize_t size)
+{
+    while (position < size && message[position] != 0)
+    {
+        if ((message[position] & 0xC0) == 0xC0)
+        {
+            return position + 2;
+        }
+        position += message[position] + 1;
+    }
+    return position + 1;
+}
+
+/**
+ * Find whether a reply holds a HINFO answer.
+ *
+ * message       : Pointer to the reply.
+ * response_size : The size of the reply.
+ * returns       : True if any answer is a HINFO record.
+ */
+static bool dns_any_has_hinfo(const uint8_t *message, ssize_t response_size)
+{
+    uint16_t question_count = (message[4] << 8) | message[5];
+    uint16_t answer_count = (message[6] << 8) | message[7];
+    ssize_t position = DNS_HEADER_SIZE;
+    for (uint16_t i = 0; i < question_count; i++)
+    {
+        position = dns_any_skip_name(message, position, response_size) + 2 * sizeof(uint16_t);
+    }
+
+    // Each record is a name, then its type, class, TTL and data length.
+    for (uint16_t i = 0; i < answer_count; i++)
+    {
+        position = dns_any_skip_name(message, position, response_size);
+        if (position + 10 > response_size)
+        {
+            return false;
+        }
+        if (message[position] == 0 && message[position + 1] == DNS_RR_TYPE_HINFO)
+        {
+            return true;
+        }
+        position += 10 + ((message[position + 8] << 8) | message[position + 9]);
+    }
+    return false;
+}
+
+void dns_any_count(struct dns_any_stats *stats, const uint8_t *message, ssize_t message_size, ssize_t response_size)
+{
+    // Walk the first question name, staying within the query.
+    ssize_t position = DNS_HEADER_SIZE;
+    while (position < message_size && message[position] != 0)
+    {
+        position += message[position] + 1;
+    }
+    if (position + 3 > message_size || message[position + 1] != 0 || message[position + 2] != DNS_RR_TYPE_ANY)
+    {
+        return;
+    }
+
+    stats->queries++;
+    stats->response_bytes += response_size;
+    if (message[2] & (DNS_FLAG_TC >> 8))
+    {
+        stats->truncated++;
+    }
+    else if (dns_any_has_hinfo(message, response_size))
+    {
+        stats->hinfo++;
+    }
+    else
+    {
+        stats->answered++;
+    }
+}
+
+void dns_any_print_stats(const struct dns_any_stats *stats, FILE *stream)
+{
+    fprintf(stream, "any: queries=%lu answered=%lu hinfo=%lu truncated=%lu average_response_bytes=%lu\n",
+            (unsigned long)stats->queries, (unsigned long)stats->answered, (unsigned long)stats->hinfo,
+            (unsigned long)stats->truncated, (unsigned long)(stats->queries ? stats->response_bytes / stats->queries : 0));
+}
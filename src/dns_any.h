@@ -0,0 +1,80 @@
+/**
+ * Contains the handling of ANY queries described in RFC 8482. Almost all ANY
+ * traffic is abuse, so instead of answering it like an A query the daemon
+ * can reply with a single precompiled HINFO record (CPU "RFC8482", empty OS)
+ * or with an empty truncated reply that sends legitimate clients to TCP.
+ */
+#ifndef DNS_ANY_H
+#define DNS_ANY_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+// The size of the HINFO record, with a compressed name, RFC 8482 4.2.
+#define DNS_ANY_HINFO_SIZE 21
+
+// The HINFO resource record type, RFC 1035 3.2.2.
+#define DNS_RR_TYPE_HINFO 13
+
+/**
+ * How ANY questions are answered.
+ */
+enum dns_any_mode
+{
+    DNS_ANY_ANSWER,   // Like A questions, with every address of the policy.
+    DNS_ANY_HINFO,    // With the synthesized HINFO record of RFC 8482 4.2.
+    DNS_ANY_TRUNCATE, // With no answers and the TC flag set, RFC 8482 4.4.
+};
+
+/**
+ * Counters of the ANY queries handled by a processing loop.
+ */
+struct dns_any_stats
+{
+    uint64_t queries;
+    uint64_t answered;
+    uint64_t hinfo;
+    uint64_t truncated;
+    uint64_t response_bytes; // The total size of the replies to ANY queries.
+};
+
+/**
+ * Parse a mode given as "answer", "hinfo" or "truncate".
+ *
+ * text    : The name of the mode.
+ * mode    : Set to the parsed mode.
+ * returns : True if the name was valid.
+ */
+bool dns_any_parse_mode(const char *text, enum dns_any_mode *mode);
+
+/**
+ * Append the precompiled HINFO record to a response.
+ *
+ * name_position : The position of the question name, for name compression.
+ * message       : Pointer to the response being built.
+ * response_size : Pointer to the size of the response, updated.
+ */
+void dns_any_append_hinfo(uint16_t name_position, uint8_t *message, ssize_t *response_size);
+
+/**
+ * Count a reply if its first question is an ANY question, by what the reply
+ * holds: truncated if it sets TC, HINFO if it has a HINFO answer, and
+ * answered otherwise, errors included.
+ *
+ * stats         : Pointer to the counters to update.
+ * message       : Pointer to the reply, which still holds the questions.
+ * message_size  : The size of the query, bounding the question.
+ * response_size : The size of the reply.
+ */
+void dns_any_count(struct dns_any_stats *stats, const uint8_t *message, ssize_t message_size, ssize_t response_size);
+
+/**
+ * Print the counters of ANY queries.
+ *
+ * stats  : Pointer to the counters to print.
+ * stream : The stream to print to.
+ */
+void dns_any_print_stats(const struct dns_any_stats *stats, FILE *stream);
+
+#endif // DNS_ANY_H
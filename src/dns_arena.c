@@ -0,0 +1,185 @@
+/**
+ * DNS Arena
+ * Contains implementation of the memory budget. The arena is a single
+ * anonymous mapping, faulted in with MAP_POPULATE so the first burst of
+ * queries takes no page faults, see mmap(2) and mlock(2).
+*/
+
+#define _GNU_SOURCE
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "dns_arena.h"
+
+// The size of a huge page, the arena is rounded up to a multiple of it.
+#define DNS_ARENA_HUGEPAGE_SIZE (2 << 20)
+
+size_t dns_arena_parse_size(const char *text)
+{
+    char *end;
+    unsigned long long size = strtoull(text, &end, 10);
+    int shift = 0;
+    switch (*end)
+    {
+    case 'G':
+    case 'g':
+        shift += 10;
+        // Fall through.
+    case 'M':
+    case 'm':
+        shift += 10;
+        // Fall through.
+    case 'K':
+    case 'k':
+        shift += 10;
+        end++;
+        break;
+    }
+    if (end == text || *end != '\0' || size > (SIZE_MAX >> shift))
+    {
+        return 0;
+    }
+    return size << shift;
+}
+
+void dns_arena_init(struct dns_arena *arena, size_t size, int flags)
+{
+    memset(arena, 0, sizeof(*arena));
+    if (size == 0)
+    {
+        return;
+    }
+
+    // Huge pages are only mapped whole, but the budget stays as requested.
+    void *base = MAP_FAILED;
+    size_t mapped_size = size;
+    if (flags & DNS_ARENA_HUGEPAGES)
+    {
+        mapped_size = (size + DNS_ARENA_HUGEPAGE_SIZE - 1) & ~(size_t)(DNS_ARENA_HUGEPAGE_SIZE - 1);
+        base = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE | MAP_HUGETLB, -1, 0);
+        if (base == MAP_FAILED)
+        {
+            warn("No huge pages for the %zu byte arena (see vm.nr_hugepages), using normal pages", size);
+            mapped_size = size;
+        }
+    }
+    arena->hugepages = base != MAP_FAILED;
+    if (base == MAP_FAILED)
+    {
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (base == MAP_FAILED)
+        {
+            err(1, "mmap %zu byte arena", size);
+        }
+        // Transparent huge pages still cut TLB misses, when enabled.
+        if (flags & DNS_ARENA_HUGEPAGES)
+        {
+            madvise(base, size, MADV_HUGEPAGE);
+        }
+    }
+    if ((flags & DNS_ARENA_LOCK) && mlock(base, mapped_size))
+    {
+        err(1, "mlock %zu byte arena (see RLIMIT_MEMLOCK)", mapped_size);
+    }
+    arena->base = base;
+    arena->size = size;
+    arena->mapped_size = mapped_size;
+    arena->locked = flags & DNS_ARENA_LOCK;
+}
+
+/**
+ * Add a block to the breakdown of the arena.
+ *
+ * arena : Pointer to the arena.
+ * size  : The size of the block.
+ * name  : The use of the block.
+ */
+static void dns_arena_record(struct dns_arena *arena, size_t size, const char *name)
+{
+    int use = 0;
+    while (use < arena->use_count && strcmp(arena->uses[use].name, name) != 0)
+    {
+        use++;
+    }
+    if (use == arena->use_count)
+    {
+        if (use == DNS_ARENA_MAX_USES)
+        {
+            use--;
+            name = "other";
+        }
+        else
+        {
+            arena->use_count++;
+        }
+        arena->uses[use].name = name;
+    }
+    arena->uses[use].size += size;
+    arena->uses[use].blocks++;
+}
+
+void *dns_arena_alloc(struct dns_arena *arena, size_t size, const char *name)
+{
+    size_t aligned_size = (size + DNS_ARENA_ALIGNMENT - 1) & ~(size_t)(DNS_ARENA_ALIGNMENT - 1);
+    if (arena->base == NULL)
+    {
+        void *block = aligned_alloc(DNS_ARENA_ALIGNMENT, aligned_size ? aligned_size : DNS_ARENA_ALIGNMENT);
+        if (block == NULL)
+        {
+            err(1, "aligned_alloc");
+        }
+        memset(block, 0, aligned_size);
+        arena->used += aligned_size;
+        dns_arena_record(arena, aligned_size, name);
+        return block;
+    }
+
+    if (aligned_size > arena->size - arena->used)
+    {
+        dns_arena_print(arena, stderr);
+        errx(1, "Memory budget of %zu bytes exceeded: %s needs %zu bytes, %zu are left", arena->size, name, aligned_size, arena->size - arena->used);
+    }
+    // The mapping starts zeroed and blocks are never reused.
+    void *block = arena->base + arena->used;
+    arena->used += aligned_size;
+    dns_arena_record(arena, aligned_size, name);
+    return block;
+}
+
+void *dns_arena_copy(struct dns_arena *arena, const void *data, size_t size, const char *name)
+{
+    void *block = dns_arena_alloc(arena, size, name);
+    if (size > 0)
+    {
+        memcpy(block, data, size);
+    }
+    return block;
+}
+
+void dns_arena_print(const struct dns_arena *arena, FILE *stream)
+{
+    if (arena->base)
+    {
+        fprintf(stream, "memory: budget=%zu used=%zu (%.1f%%) hugepages=%s locked=%s\n", arena->size, arena->used,
+                arena->used * 100.0 / arena->size, arena->hugepages ? "yes" : "no", arena->locked ? "yes" : "no");
+    }
+    else
+    {
+        fprintf(stream, "memory: no budget, used=%zu\n", arena->used);
+    }
+    for (int use = 0; use < arena->use_count; use++)
+    {
+        fprintf(stream, "  %-20s %12zu bytes in %zu blocks\n", arena->uses[use].name, arena->uses[use].size, arena->uses[use].blocks);
+    }
+}
+
+void dns_arena_free(struct dns_arena *arena)
+{
+    if (arena->base)
+    {
+        munmap(arena->base, arena->mapped_size);
+    }
+    memset(arena, 0, sizeof(*arena));
+}
@@ -0,0 +1,109 @@
+/**
+ * Contains a fixed memory budget for the state the daemon keeps while it
+ * runs. A single arena is mapped and faulted in at startup, optionally on
+ * huge pages and locked in memory, and every buffer, cache and table that
+ * queries touch is carved from it. Nothing is ever freed back to the arena,
+ * and going over the budget stops the daemon before it starts serving.
+ */
+#ifndef DNS_ARENA_H
+#define DNS_ARENA_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// The alignment of every carved block, a cache line.
+#define DNS_ARENA_ALIGNMENT 64
+
+// The number of distinct uses reported in the breakdown.
+#define DNS_ARENA_MAX_USES 32
+
+// Flags of dns_arena_init().
+#define DNS_ARENA_HUGEPAGES 0x1 // Back the arena with huge pages.
+#define DNS_ARENA_LOCK 0x2      // Lock the arena in memory.
+
+/**
+ * The memory carved for one use, such as the packet buffers of every worker.
+ */
+struct dns_arena_use
+{
+    const char *name;
+    size_t size;
+    size_t blocks;
+};
+
+/**
+ * A memory budget and the uses it was carved into.
+ */
+struct dns_arena
+{
+    uint8_t *base; // NULL without a budget, blocks then come from the heap.
+    size_t size;
+    size_t mapped_size; // The size rounded up to whole huge pages when on them.
+    size_t used;
+    bool hugepages; // Whether the arena ended up on huge pages.
+    bool locked;
+    struct dns_arena_use uses[DNS_ARENA_MAX_USES];
+    int use_count;
+};
+
+/**
+ * Parse a size given in bytes, or with a K, M or G suffix.
+ *
+ * text    : The size.
+ * returns : The size in bytes, or 0 if the text is not a valid size.
+ */
+size_t dns_arena_parse_size(const char *text);
+
+/**
+ * Map and fault in an arena. Huge pages fall back to normal pages with a
+ * warning when none are reserved, while failing to lock the arena is an
+ * error.
+ *
+ * arena : Pointer to the arena to initialize.
+ * size  : The budget in bytes, or 0 to carve blocks from the heap without
+ *         a budget.
+ * flags : DNS_ARENA_HUGEPAGES and DNS_ARENA_LOCK.
+ */
+void dns_arena_init(struct dns_arena *arena, size_t size, int flags);
+
+/**
+ * Carve a zeroed block from the arena, exiting with the breakdown of the
+ * budget if it does not fit.
+ *
+ * arena   : Pointer to the arena.
+ * size    : The size of the block.
+ * name    : The use of the block, for the breakdown.
+ * returns : The block, aligned to DNS_ARENA_ALIGNMENT.
+ */
+void *dns_arena_alloc(struct dns_arena *arena, size_t size, const char *name);
+
+/**
+ * Carve a block from the arena holding a copy of some data, so that data
+ * built on the heap while loading can move into the budget.
+ *
+ * arena   : Pointer to the arena.
+ * data    : The data to copy.
+ * size    : The size of the data.
+ * name    : The use of the block, for the breakdown.
+ * returns : The copy.
+ */
+void *dns_arena_copy(struct dns_arena *arena, const void *data, size_t size, const char *name);
+
+/**
+ * Print the size of every use of the arena, and what is left of the budget.
+ *
+ * arena  : Pointer to the arena.
+ * stream : The stream to print to.
+ */
+void dns_arena_print(const struct dns_arena *arena, FILE *stream);
+
+/**
+ * Release the arena. Blocks carved from the heap without a budget live as
+ * long as the process.
+ *
+ * arena : Pointer to the arena to free.
+ */
+void dns_arena_free(struct dns_arena *arena);
+
+#endif // DNS_ARENA_H
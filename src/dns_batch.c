@@ -0,0 +1,80 @@
+/**
+ * DNS Batch
+ * Contains implementation of checking the headers of a batch of packets with
+ * GCC vector extensions, which compile to SIMD instructions on every target
+ * and fall back to scalar code where there are none.
+*/
+
+#include <string.h>
+
+#include "dns_batch.h"
+
+// Sixteen 16 bit lanes, two SSE2 or one AVX2 register.
+typedef uint16_t dns_batch_lanes __attribute__((vector_size(32)));
+typedef int16_t dns_batch_mask __attribute__((vector_size(32)));
+#define DNS_BATCH_LANES (sizeof(dns_batch_lanes) / sizeof(uint16_t))
+
+_Static_assert(DNS_BATCH_SIZE % DNS_BATCH_LANES == 0, "DNS_BATCH_SIZE must be a multiple of the vector lanes");
+
+void dns_batch_load(struct dns_batch *batch, uint8_t *const *messages, const ssize_t *sizes, uint32_t count)
+{
+    if (count > DNS_BATCH_SIZE)
+    {
+        count = DNS_BATCH_SIZE;
+    }
+    memset(batch, 0, sizeof(*batch));
+    batch->count = count;
+
+    // Gather the headers, a packet too short for its header fails the size
+    // check below whatever the fields hold.
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint16_t header[DNS_HEADER_SIZE / sizeof(uint16_t)] = {0};
+        batch->messages[i] = messages[i];
+        batch->sizes[i] = sizes[i] > 0 ? (uint16_t)sizes[i] : 0;
+        memcpy(header, messages[i], batch->sizes[i] < DNS_HEADER_SIZE ? batch->sizes[i] : DNS_HEADER_SIZE);
+        batch->flags[i] = ntohs(header[DNS_POSITION_FLAGS / sizeof(uint16_t)]);
+        batch->qdcount[i] = ntohs(header[DNS_POSITION_QDCOUNT / sizeof(uint16_t)]);
+        batch->ancount[i] = ntohs(header[DNS_POSITION_ANCOUNT / sizeof(uint16_t)]);
+        batch->nscount[i] = ntohs(header[DNS_POSITION_NSCOUNT / sizeof(uint16_t)]);
+    }
+
+    // Check every lane at once: a standard query with between one and
+    // DNS_MAX_QUESTIONS questions and no answer or authority records. A zero
+    // question count wraps around and fails the range check.
+    for (uint32_t i = 0; i < DNS_BATCH_SIZE; i += DNS_BATCH_LANES)
+    {
+        dns_batch_lanes lane_sizes, flags, qdcount, ancount, nscount;
+        memcpy(&lane_sizes, batch->sizes + i, sizeof(lane_sizes));
+        memcpy(&flags, batch->flags + i, sizeof(flags));
+        memcpy(&qdcount, batch->qdcount + i, sizeof(qdcount));
+        memcpy(&ancount, batch->ancount + i, sizeof(ancount));
+        memcpy(&nscount, batch->nscount + i, sizeof(nscount));
+        dns_batch_mask valid = (lane_sizes >= DNS_HEADER_SIZE) &
+                               ((flags & (DNS_FLAG_QR | DNS_FLAG_OPCODE)) == 0) &
+                               ((qdcount - 1) < DNS_MAX_QUESTIONS) &
+                               ((ancount | nscount) == 0);
+        memcpy(batch->valid + i, &valid, sizeof(valid));
+    }
+}
+
+ssize_t dns_batch_parse(const struct dns_batch *batch, uint32_t index, const struct dns_answer_policy *policy)
+{
+    // The question of the next packet is read and rewritten next.
+    if (index + 1 < batch->count)
+    {
+        __builtin_prefetch(batch->messages[index + 1] + DNS_HEADER_SIZE, 1);
+    }
+
+    uint8_t *message = batch->messages[index];
+    if (!batch->valid[index])
+    {
+        return parse_message(message, batch->sizes[index], policy);
+    }
+
+    // The checks of parse_message() already passed, so only its header
+    // updates remain before the questions are answered.
+    set_dns_arcount(message, 0);
+    set_default_dns_flags(message);
+    return add_answers(message, batch->qdcount[index], batch->sizes[index], policy);
+}
@@ -0,0 +1,55 @@
+/**
+ * Contains the batch processing API. The header fields of a batch of received
+ * packets are first pulled into structure-of-arrays form, so that the checks
+ * parse_message() makes one packet at a time (the QR flag, opcode and the
+ * question, answer and authority counts) run as vector operations across the
+ * whole batch. Standard queries that pass the checks go straight to question
+ * processing, while anything else takes the parse_message() path, so replies
+ * are the same as when packets are parsed one by one.
+ */
+#ifndef DNS_BATCH_H
+#define DNS_BATCH_H
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "dns_defns.h"
+#include "dns_manager.h"
+
+/**
+ * The packets of a batch and their header fields, in host byte order. Lanes
+ * past the packet count are zero and never valid.
+ */
+struct dns_batch
+{
+    uint32_t count;
+    uint8_t *messages[DNS_BATCH_SIZE];
+    uint16_t sizes[DNS_BATCH_SIZE] __attribute__((aligned(32)));
+    uint16_t flags[DNS_BATCH_SIZE] __attribute__((aligned(32)));
+    uint16_t qdcount[DNS_BATCH_SIZE] __attribute__((aligned(32)));
+    uint16_t ancount[DNS_BATCH_SIZE] __attribute__((aligned(32)));
+    uint16_t nscount[DNS_BATCH_SIZE] __attribute__((aligned(32)));
+    int16_t valid[DNS_BATCH_SIZE] __attribute__((aligned(32))); // All ones if the checks passed.
+};
+
+/**
+ * Load the headers of received packets into the batch and check them all.
+ *
+ * batch    : Pointer to the batch to fill in.
+ * messages : The received packets, each in a DNS_UDP_MAX_SIZE buffer.
+ * sizes    : The size of each received packet.
+ * count    : The number of packets, at most DNS_BATCH_SIZE.
+ */
+void dns_batch_load(struct dns_batch *batch, uint8_t *const *messages, const ssize_t *sizes, uint32_t count);
+
+/**
+ * Answer a packet of the batch in place, as parse_message() would, and
+ * prefetch the next packet.
+ *
+ * batch   : Pointer to the loaded batch.
+ * index   : The index of the packet within the batch.
+ * policy  : The policy deciding which address each question is answered with.
+ * returns : Size of the response, as for parse_message().
+ */
+ssize_t dns_batch_parse(const struct dns_batch *batch, uint32_t index, const struct dns_answer_policy *policy);
+
+#endif // DNS_BATCH_H
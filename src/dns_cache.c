@@ -0,0 +1,111 @@
+/**
+ * DNS Cache
+ * Contains implementation of a direct-mapped cache of generated responses,
+ * keyed by a hash of the raw query counts and question bytes.
+*/
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "dns_cache.h"
+#include "dns_defns.h"
+#include "dns_manager.h"
+
+/**
+ * Hash the given bytes with 32 bit FNV-1a, which is cheap for short keys such
+ * as a single question.
+ * See http://www.isthe.com/chongo/tech/comp/fnv/index.html
+ *
+ * key  : Pointer to the bytes to hash.
+ * size : Number of bytes to hash.
+ * returns : The 32 bit hash.
+ */
+static uint32_t dns_cache_hash(const uint8_t *key, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void dns_cache_init(struct dns_cache *cache)
+{
+    memset(cache, 0, sizeof(*cache));
+}
+
+ssize_t dns_cache_lookup(struct dns_cache *cache, uint8_t *message, ssize_t message_size, uint32_t variant)
+{
+    cache->pending_key_size = 0;
+
+    // Responses are dropped by parse_message(), so never answer them from here.
+    if (message_size <= DNS_POSITION_QDCOUNT || (get_dns_flags(message) & DNS_FLAG_QR))
+    {
+        return 0;
+    }
+
+    const uint8_t *key = message + DNS_POSITION_QDCOUNT;
+    uint16_t key_size = message_size - DNS_POSITION_QDCOUNT;
+    uint32_t hash = dns_cache_hash(key, key_size) ^ (variant * 2654435761u);
+
+    struct dns_cache_entry *entry = &cache->entries[hash & (DNS_CACHE_SLOTS - 1)];
+    if (entry->key_size == key_size && entry->hash == hash && entry->variant == variant && memcmp(entry->key, key, key_size) == 0)
+    {
+        cache->hits++;
+        memcpy(message + DNS_POSITION_QDCOUNT, entry->response, entry->response_size - DNS_POSITION_QDCOUNT);
+        // The ID is already in place, so only the flags need to be patched.
+        set_default_dns_flags(message);
+        set_dns_flags(message, get_dns_flags(message) | entry->rcode);
+        return entry->response_size;
+    }
+
+    // Remember the key, parse_message() overwrites the query in place.
+    cache->misses++;
+    cache->pending_hash = hash;
+    cache->pending_variant = variant;
+    cache->pending_key_size = key_size;
+    memcpy(cache->pending_key, key, key_size);
+    return 0;
+}
+
+void dns_cache_insert(struct dns_cache *cache, uint8_t *response, ssize_t response_size)
+{
+    uint16_t key_size = cache->pending_key_size;
+    cache->pending_key_size = 0;
+
+    // Only cache answers and name errors that fit in an entry, other errors
+    // do not carry the default flags.
+    if (key_size == 0 || response_size <= DNS_HEADER_SIZE || response_size > DNS_UDP_MAX_SIZE)
+    {
+        return;
+    }
+    uint16_t rcode = get_dns_flags(response) & DNS_FLAG_RCODE_MASK;
+    if (rcode != 0 && rcode != DNS_FLAG_RCODE_NAME_ERROR)
+    {
+        return;
+    }
+
+    struct dns_cache_entry *entry = &cache->entries[cache->pending_hash & (DNS_CACHE_SLOTS - 1)];
+    if (entry->key_size)
+    {
+        cache->evictions++;
+    }
+    entry->hash = cache->pending_hash;
+    entry->variant = cache->pending_variant;
+    entry->key_size = key_size;
+    entry->response_size = response_size;
+    entry->rcode = rcode | (get_dns_flags(response) & DNS_FLAG_TC);
+    memcpy(entry->key, cache->pending_key, key_size);
+    memcpy(entry->response, response + DNS_POSITION_QDCOUNT, response_size - DNS_POSITION_QDCOUNT);
+    cache->insertions++;
+}
+
+void dns_cache_print_stats(const struct dns_cache *cache, FILE *stream)
+{
+    uint64_t lookups = cache->hits + cache->misses;
+    double hit_rate = lookups ? 100.0 * cache->hits / lookups : 0.0;
+    fprintf(stream, "cache: slots=%d hits=%" PRIu64 " misses=%" PRIu64 " hit_rate=%.1f%% insertions=%" PRIu64 " evictions=%" PRIu64 "\n",
+            DNS_CACHE_SLOTS, cache->hits, cache->misses, hit_rate, cache->insertions, cache->evictions);
+}
@@ -0,0 +1,95 @@
+/**
+ * Contains a small direct-mapped response cache. Repeated identical questions
+ * are answered by copying a previously built response into the message
+ * instead of walking and validating the questions again.
+ */
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+#include <stdio.h>
+#include <sys/types.h>
+#include <stdint.h>
+
+#include "dns_defns.h"
+
+// The number of cache slots, must be a power of two so the slot can be
+// selected with a mask.
+#define DNS_CACHE_SLOTS 256
+
+/**
+ * A single cached response. The key holds the query starting at the QD count
+ * (counts and questions), while the response holds the generated response
+ * starting at the same position, so a hit only needs the ID and flags patched.
+ */
+struct dns_cache_entry
+{
+    uint32_t hash;
+    uint32_t variant;
+    uint16_t key_size; // Zero when the slot is empty.
+    uint16_t response_size;
+    uint16_t rcode; // The response code, and the truncation flag.
+    uint8_t key[DNS_UDP_MAX_SIZE];
+    uint8_t response[DNS_UDP_MAX_SIZE];
+};
+
+/**
+ * A fixed-size cache owned by a single processing loop. It takes no locks and
+ * performs no allocation.
+ */
+struct dns_cache
+{
+    struct dns_cache_entry entries[DNS_CACHE_SLOTS];
+
+    // Key of the last miss, kept until the response is inserted.
+    uint32_t pending_hash;
+    uint32_t pending_variant;
+    uint16_t pending_key_size;
+    uint8_t pending_key[DNS_UDP_MAX_SIZE];
+
+    // Counters used to size the cache.
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t evictions;
+};
+
+/**
+ * Reset the cache to an empty state and clear its counters.
+ *
+ * cache : Pointer to the cache to initialize.
+ */
+void dns_cache_init(struct dns_cache *cache);
+
+/**
+ * Look up the query in the cache. On a hit, the cached response is copied into
+ * the message and its ID and flags are patched in place. On a miss, the key is
+ * remembered so that a following dns_cache_insert() call can store the
+ * response.
+ *
+ * cache        : Pointer to the cache to search.
+ * message      : Pointer to the incoming query.
+ * message_size : Size of the incoming query.
+ * variant      : Distinguishes queries answered differently, such as those
+ *                arriving on local addresses with their own answer set.
+ * returns      : Size of the response on a hit, zero on a miss.
+ */
+ssize_t dns_cache_lookup(struct dns_cache *cache, uint8_t *message, ssize_t message_size, uint32_t variant);
+
+/**
+ * Store the response generated for the query of the last miss. Only answers
+ * and name errors are cached.
+ *
+ * cache         : Pointer to the cache to insert into.
+ * response      : Pointer to the generated response.
+ * response_size : Size of the generated response.
+ */
+void dns_cache_insert(struct dns_cache *cache, uint8_t *response, ssize_t response_size);
+
+/**
+ * Print the hit-rate counters of the cache.
+ *
+ * cache  : Pointer to the cache to report on.
+ * stream : The stream to print to.
+ */
+void dns_cache_print_stats(const struct dns_cache *cache, FILE *stream);
+
+#endif // DNS_CACHE_H
@@ -0,0 +1,223 @@
+/**
+ * DNS Config
+ * Contains implementation of loading the listeners of a configuration file.
+ * The file is read whole and split in place, so every string of the
+ * configuration points into a single buffer.
+*/
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "dns_config.h"
+
+// The port listened on when none is given.
+#define DNS_CONFIG_DEFAULT_PORT 12345
+
+void dns_config_init_listener(struct dns_listener_config *listener)
+{
+    memset(listener, 0, sizeof(*listener));
+    listener->port = DNS_CONFIG_DEFAULT_PORT;
+    listener->family = AF_INET;
+}
+
+bool dns_config_set(struct dns_listener_config *listener, const char *key, char *value)
+{
+    if (strcmp(key, "port") == 0)
+    {
+        char *end;
+        unsigned long port = strtoul(value, &end, 0);
+        if (*end != '\0' || port == 0 || port > 65535)
+        {
+            return false;
+        }
+        listener->port = port;
+    }
+    else if (strcmp(key, "path") == 0)
+    {
+        struct sockaddr_un address;
+        if (value[0] != '/' || strlen(value) >= sizeof(address.sun_path))
+        {
+            return false;
+        }
+        listener->path = value;
+        listener->family = AF_UNIX;
+        listener->port = 0;
+    }
+    else if (strcmp(key, "family") == 0)
+    {
+        // Unix sockets have no other family.
+        if (listener->path)
+        {
+            return false;
+        }
+        if (strcmp(value, "inet") == 0)
+        {
+            listener->family = AF_INET;
+        }
+        else if (strcmp(value, "inet6") == 0)
+        {
+            listener->family = AF_INET6;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (strcmp(key, "address") == 0)
+    {
+        // Validate the address the way the answer set will parse it.
+        struct dns_answer_set check;
+        dns_answer_init(&check);
+        if (listener->address_count == DNS_CONFIG_MAX_ADDRESSES || !dns_answer_add(&check, value))
+        {
+            return false;
+        }
+        listener->addresses[listener->address_count++] = value;
+    }
+    else if (strcmp(key, "list") == 0)
+    {
+        if (listener->list_count == DNS_CONFIG_MAX_LISTS)
+        {
+            return false;
+        }
+        listener->lists[listener->list_count++] = value;
+    }
+    else if (strcmp(key, "patterns") == 0)
+    {
+        listener->patterns = value;
+    }
+    else if (strcmp(key, "any") == 0)
+    {
+        return dns_any_parse_mode(value, &listener->any);
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Parse the words of a "listen" line into a listener.
+ *
+ * listener : Pointer to the listener to fill in.
+ * words    : The words of the line after "listen", split in place.
+ * returns  : True if every word was valid.
+ */
+static bool dns_config_parse_listener(struct dns_listener_config *listener, char *words)
+{
+    dns_config_init_listener(listener);
+    char *word = strtok(words, " \t");
+    if (word == NULL || !dns_config_set(listener, word[0] == '/' ? "path" : "port", word))
+    {
+        return false;
+    }
+    while ((word = strtok(NULL, " \t")) != NULL)
+    {
+        char *separator = strchr(word, '=');
+        if (separator == NULL)
+        {
+            return false;
+        }
+        *separator = '\0';
+        if (!dns_config_set(listener, word, separator + 1))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void dns_config_load(struct dns_config *config, const char *path)
+{
+    memset(config, 0, sizeof(*config));
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        err(1, "%s", path);
+    }
+    if (fseek(file, 0, SEEK_END) || ftell(file) < 0)
+    {
+        err(1, "%s", path);
+    }
+    size_t size = ftell(file);
+    rewind(file);
+    config->text = malloc(size + 1);
+    if (config->text == NULL)
+    {
+        err(1, "malloc");
+    }
+    if (fread(config->text, 1, size, file) != size)
+    {
+        err(1, "%s", path);
+    }
+    config->text[size] = '\0';
+    fclose(file);
+
+    // Lines are split first, strtok() then splits the words of each line.
+    int line_number = 0;
+    char *next_line = config->text;
+    while (next_line)
+    {
+        char *line = next_line;
+        line_number++;
+        next_line = strchr(line, '\n');
+        if (next_line)
+        {
+            *next_line++ = '\0';
+        }
+        char *comment = strchr(line, '#');
+        if (comment)
+        {
+            *comment = '\0';
+        }
+        line += strspn(line, " \t\r");
+        line[strcspn(line, "\r")] = '\0';
+        if (*line == '\0')
+        {
+            continue;
+        }
+
+        if (strncmp(line, "listen", 6) != 0 || (line[6] != ' ' && line[6] != '\t'))
+        {
+            errx(1, "%s:%d: Expected a listen line", path, line_number);
+        }
+        if (config->listener_count == DNS_CONFIG_MAX_LISTENERS)
+        {
+            errx(1, "%s:%d: More than %d listeners", path, line_number, DNS_CONFIG_MAX_LISTENERS);
+        }
+        struct dns_listener_config *listener = &config->listeners[config->listener_count];
+        if (!dns_config_parse_listener(listener, line + 6))
+        {
+            errx(1, "%s:%d: Listener invalid", path, line_number);
+        }
+        for (int i = 0; i < config->listener_count; i++)
+        {
+            const struct dns_listener_config *other = &config->listeners[i];
+            if (listener->path && other->path && strcmp(other->path, listener->path) == 0)
+            {
+                errx(1, "%s:%d: Path %s is already listened on", path, line_number, listener->path);
+            }
+            if (listener->path == NULL && other->path == NULL && other->port == listener->port)
+            {
+                errx(1, "%s:%d: Port %d is already listened on", path, line_number, listener->port);
+            }
+        }
+        config->listener_count++;
+    }
+    if (config->listener_count == 0)
+    {
+        errx(1, "%s: No listeners", path);
+    }
+}
+
+void dns_config_free(struct dns_config *config)
+{
+    free(config->text);
+    config->text = NULL;
+    config->listener_count = 0;
+}
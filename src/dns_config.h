@@ -0,0 +1,92 @@
+/**
+ * Contains the configuration file describing several listeners served by a
+ * single daemon. Each line of the file starting with "listen" describes one
+ * listener, its port and its answer policy, with the same meaning as the
+ * command line options:
+ *
+ *     # Sinkhole ads for the whole host, rotating over two servers.
+ *     listen 53 family=inet6 address=10.0.0.1@3 address=10.0.0.2 list=ads.txt
+ *     listen 5353 address=6.6.6.6 patterns=tracking.dfa any=hinfo
+ *     listen /run/dnsspoof.sock list=ads.txt
+ *
+ * A listener given a path in place of a port listens on a Unix datagram
+ * socket at that path, for resolvers running on the same host. Blank lines
+ * are skipped and '#' starts a comment. Options may appear in any order, and
+ * address and list may be repeated.
+ */
+#ifndef DNS_CONFIG_H
+#define DNS_CONFIG_H
+#include <stdbool.h>
+
+#include "dns_answer.h"
+#include "dns_any.h"
+
+// The maximum number of listeners of a daemon.
+#define DNS_CONFIG_MAX_LISTENERS 16
+
+// The maximum number of addresses and of list files of a listener.
+#define DNS_CONFIG_MAX_ADDRESSES (2 * DNS_ANSWER_MAX_ADDRESSES)
+#define DNS_CONFIG_MAX_LISTS 64
+
+/**
+ * The description of a single listener. The strings point into the text of
+ * the configuration file, or into the command line.
+ */
+struct dns_listener_config
+{
+    int port;
+    int family; // AF_INET, AF_INET6 for a dual-stack socket, or AF_UNIX.
+    char *path; // The path of a Unix socket, or NULL.
+    char *addresses[DNS_CONFIG_MAX_ADDRESSES];
+    int address_count;
+    char *lists[DNS_CONFIG_MAX_LISTS];
+    int list_count;
+    char *patterns;        // The pattern file, or NULL.
+    enum dns_any_mode any; // How ANY questions are answered.
+};
+
+/**
+ * The listeners of a configuration file.
+ */
+struct dns_config
+{
+    struct dns_listener_config listeners[DNS_CONFIG_MAX_LISTENERS];
+    int listener_count;
+    char *text; // The contents of the file, holding every string.
+};
+
+/**
+ * Initialize a listener with the default port and family and no options.
+ *
+ * listener : Pointer to the listener to initialize.
+ */
+void dns_config_init_listener(struct dns_listener_config *listener);
+
+/**
+ * Check an option of a listener and add it to the listener.
+ *
+ * listener : Pointer to the listener to add to.
+ * key      : The name of the option: port, path, family, address, list,
+ *            patterns or any.
+ * value    : The value of the option, kept by the listener.
+ * returns  : True if the option was valid and added.
+ */
+bool dns_config_set(struct dns_listener_config *listener, const char *key, char *value);
+
+/**
+ * Load a configuration file, exiting with the file name and line on an
+ * invalid line.
+ *
+ * config : Pointer to the configuration to fill in, freed with dns_config_free().
+ * path   : The path of the configuration file.
+ */
+void dns_config_load(struct dns_config *config, const char *path);
+
+/**
+ * Release the text held by a configuration.
+ *
+ * config : Pointer to the configuration to free.
+ */
+void dns_config_free(struct dns_config *config);
+
+#endif // DNS_CONFIG_H
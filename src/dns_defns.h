@@ -19,24 +19,28 @@
 // Size parameters, as specified in RFC 1035 2.3.4. and 4.1.1.
 #define DNS_HEADER_SIZE 12
 #define DNS_NAME_MAX_SIZE 255
-#define DNS_UDP_MAX_SIZE 255
+#define DNS_UDP_MAX_SIZE 512
 #define DNS_LABEL_MAX_SIZE 63
 
 // Flag definitions for manipulation of entire vector.
 // Defined in RFC 1035 4.1.4.
 // Precalculation strategy from https://stackoverflow.com/questions/14717497/what-is-the-most-performant-correct-way-of-doing-a-bit-shift-mask
 #define DNS_FLAG_QR 0x8000
-#define DNS_FLAG_OPCODE 0x7400
+#define DNS_FLAG_OPCODE 0x7800
 #define DNS_FLAG_AA 0x0400
+#define DNS_FLAG_TC 0x0200
 #define DNS_FLAG_RD 0x0100
 #define DNS_FLAG_RA 0x0080
 #define DNS_FLAG_Z 0x0070
 #define DNS_FLAG_RCODE_MASK 0x000F
 #define DNS_FLAG_RCODE_FORMAT_ERROR 0x0001
+#define DNS_FLAG_RCODE_NAME_ERROR 0x0003
 #define DNS_FLAG_RCODE_NOT_IMPLEMENTED 0x0004
+#define DNS_FLAG_RCODE_REFUSED 0x0005
 
 // Supported Resource Record types, specified in RFC 1035 3.2.3.
 #define DNS_RR_TYPE_A 1     // A host address.
+#define DNS_RR_TYPE_AAAA 28 // An IPv6 host address, RFC 3596 2.1.
 #define DNS_RR_TYPE_ANY 255 // Any record.
 
 // Supported Resource Record classes, specified in RFC 1035 3.2.4.
@@ -53,4 +57,7 @@
 // of unit testing.
 #define DNS_NUMBER_OF_PACKETS 1000
 
+// The number of packets received, validated and answered together.
+#define DNS_BATCH_SIZE 32
+
 #endif // DNS_DEFNS_H
\ No newline at end of file
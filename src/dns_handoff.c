@@ -0,0 +1,195 @@
+/**
+ * DNS Handoff
+ * Contains implementation of passing listening sockets between instances
+ * over a Unix socket. Ancillary data handling referenced from cmsg(3) and
+ * unix(7).
+*/
+
+#define _GNU_SOURCE
+#include <err.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "dns_handoff.h"
+
+/**
+ * Fill in the Unix socket address for the given path.
+ *
+ * address : Pointer to the address to fill in.
+ * path    : The filesystem path of the handoff socket.
+ */
+static void handoff_address(struct sockaddr_un *address, const char *path)
+{
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address->sun_path))
+    {
+        errx(1, "Handoff path too long: %s", path);
+    }
+    strncpy(address->sun_path, path, sizeof(address->sun_path) - 1);
+}
+
+int handoff_listen(const char *path)
+{
+    struct sockaddr_un address;
+    handoff_address(&address, path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0)
+    {
+        err(1, "socket");
+    }
+
+    // The previous instance never unlinks the path, so replace it here.
+    unlink(path);
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)))
+    {
+        err(1, "bind %s", path);
+    }
+    if (listen(listener, 1))
+    {
+        err(1, "listen");
+    }
+    return listener;
+}
+
+int handoff_take_over(const char *path, int *sockets, int max_sockets, int *connection)
+{
+    struct sockaddr_un address;
+    handoff_address(&address, path);
+    *connection = -1;
+
+    int handoff_connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (handoff_connection < 0)
+    {
+        err(1, "socket");
+    }
+
+    // Nothing is serving on the path, the caller binds fresh sockets.
+    if (connect(handoff_connection, (struct sockaddr *)&address, sizeof(address)))
+    {
+        if (errno != ENOENT && errno != ECONNREFUSED)
+        {
+            warn("connect %s", path);
+        }
+        close(handoff_connection);
+        return 0;
+    }
+
+    // Receive the sockets as ancillary data alongside a single marker byte.
+    char marker;
+    struct iovec vector = {.iov_base = &marker, .iov_len = sizeof(marker)};
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int) * DNS_HANDOFF_MAX_SOCKETS)];
+        struct cmsghdr align;
+    } control;
+    struct msghdr header = {
+        .msg_iov = &vector,
+        .msg_iovlen = 1,
+        .msg_control = control.buffer,
+        .msg_controllen = sizeof(control.buffer),
+    };
+    if (recvmsg(handoff_connection, &header, MSG_CMSG_CLOEXEC) != sizeof(marker) || marker != DNS_HANDOFF_SOCKETS)
+    {
+        warnx("Handoff from %s failed, binding fresh sockets", path);
+        close(handoff_connection);
+        return 0;
+    }
+
+    int count = 0;
+    for (struct cmsghdr *message = CMSG_FIRSTHDR(&header); message; message = CMSG_NXTHDR(&header, message))
+    {
+        if (message->cmsg_level != SOL_SOCKET || message->cmsg_type != SCM_RIGHTS)
+        {
+            continue;
+        }
+        int received = (message->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int *received_sockets = (int *)CMSG_DATA(message);
+        for (int i = 0; i < received; i++)
+        {
+            if (count < max_sockets)
+            {
+                sockets[count++] = received_sockets[i];
+            }
+            else
+            {
+                close(received_sockets[i]);
+            }
+        }
+    }
+
+    if (count == 0)
+    {
+        close(handoff_connection);
+        return 0;
+    }
+    *connection = handoff_connection;
+    return count;
+}
+
+void handoff_acknowledge(int connection, bool ready)
+{
+    // Tell the old instance to stop reading, the sockets are served from here
+    // on. Closing without a word leaves it serving.
+    char marker = DNS_HANDOFF_READY;
+    if (ready && write(connection, &marker, sizeof(marker)) != sizeof(marker))
+    {
+        warn("write");
+    }
+    close(connection);
+}
+
+int handoff_give_away(int listener, const int *sockets, int count)
+{
+    int connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+    if (connection < 0)
+    {
+        warn("accept");
+        return -1;
+    }
+    if (count > DNS_HANDOFF_MAX_SOCKETS)
+    {
+        count = DNS_HANDOFF_MAX_SOCKETS;
+    }
+
+    char marker = DNS_HANDOFF_SOCKETS;
+    struct iovec vector = {.iov_base = &marker, .iov_len = sizeof(marker)};
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int) * DNS_HANDOFF_MAX_SOCKETS)];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr header = {
+        .msg_iov = &vector,
+        .msg_iovlen = 1,
+        .msg_control = control.buffer,
+        .msg_controllen = CMSG_SPACE(sizeof(int) * count),
+    };
+    struct cmsghdr *message = CMSG_FIRSTHDR(&header);
+    message->cmsg_level = SOL_SOCKET;
+    message->cmsg_type = SCM_RIGHTS;
+    message->cmsg_len = CMSG_LEN(sizeof(int) * count);
+    memcpy(CMSG_DATA(message), sockets, sizeof(int) * count);
+
+    if (sendmsg(connection, &header, MSG_NOSIGNAL) != sizeof(marker))
+    {
+        warn("sendmsg");
+        close(connection);
+        return -1;
+    }
+    return connection;
+}
+
+bool handoff_is_complete(int connection)
+{
+    char marker = 0;
+    ssize_t received = read(connection, &marker, sizeof(marker));
+    close(connection);
+    return received == sizeof(marker) && marker == DNS_HANDOFF_READY;
+}
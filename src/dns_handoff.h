@@ -0,0 +1,77 @@
+/**
+ * Contains methods used to hand the bound listening sockets from a running
+ * daemon over to a newly started one through a Unix socket with SCM_RIGHTS,
+ * so that the binary can be restarted without dropping queries.
+ *
+ * The new instance finishes warming up, connects to the handoff path and
+ * receives the sockets. It acknowledges them once it has checked they serve
+ * what it was asked to, at which point the old instance stops reading from
+ * them and exits. Without the acknowledgement the old instance keeps serving.
+ */
+#ifndef DNS_HANDOFF_H
+#define DNS_HANDOFF_H
+#include <stdbool.h>
+
+// The maximum number of sockets passed in a single handoff.
+#define DNS_HANDOFF_MAX_SOCKETS 64
+
+// Bytes exchanged over the handoff connection.
+#define DNS_HANDOFF_SOCKETS 'S'
+#define DNS_HANDOFF_READY 'R'
+
+/**
+ * Create the Unix socket that later instances connect to in order to take
+ * over the listening sockets. Any stale socket file at the path is replaced.
+ *
+ * path    : The filesystem path of the handoff socket.
+ * returns : The listening socket.
+ */
+int handoff_listen(const char *path);
+
+/**
+ * Receive the listening sockets of the instance currently serving on the
+ * given handoff path. The old instance keeps serving until the sockets are
+ * acknowledged with handoff_acknowledge(). Should only be called once this
+ * instance is ready to serve.
+ *
+ * path        : The filesystem path of the handoff socket.
+ * sockets     : Array filled with the received sockets.
+ * max_sockets : The capacity of the sockets array.
+ * connection  : Set to the handoff connection to acknowledge, or -1 if no
+ *               sockets were received.
+ * returns     : The number of sockets received, zero if no instance is running.
+ */
+int handoff_take_over(const char *path, int *sockets, int max_sockets, int *connection);
+
+/**
+ * Answer the instance the sockets were taken over from, and close the
+ * connection.
+ *
+ * connection : The connection set by handoff_take_over().
+ * ready      : True to take the sockets over so the old instance drains and
+ *              exits, false to leave it serving.
+ */
+void handoff_acknowledge(int connection, bool ready);
+
+/**
+ * Accept a pending handoff connection and send the listening sockets over it.
+ * The caller keeps serving until handoff_is_complete() reports the new
+ * instance is ready.
+ *
+ * listener : The socket returned by handoff_listen().
+ * sockets  : The listening sockets to hand over.
+ * count    : The number of listening sockets.
+ * returns  : The handoff connection, or -1 if the handoff failed.
+ */
+int handoff_give_away(int listener, const int *sockets, int count);
+
+/**
+ * Read the acknowledgement of the new instance from a readable handoff
+ * connection. The connection is closed in either case.
+ *
+ * connection : The connection returned by handoff_give_away().
+ * returns    : True if the new instance took over, false if it went away.
+ */
+bool handoff_is_complete(int connection);
+
+#endif // DNS_HANDOFF_H
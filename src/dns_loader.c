@@ -0,0 +1,334 @@
+/**
+ * DNS Loader
+ * Contains implementation of the parallel loader for hosts-file and
+ * plain-domain lists.
+*/
+
+#include <err.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "dns_defns.h"
+#include "dns_loader.h"
+
+/**
+ * A piece of a mapped list file that ends on a line boundary, along with the
+ * names parsed from it.
+ */
+struct dns_load_chunk
+{
+    const char *start;
+    size_t size;
+    struct dns_table table;
+    size_t duplicates;
+    size_t invalid;
+};
+
+/**
+ * The chunks shared by the parsing threads, which take the next unparsed
+ * chunk until none are left.
+ */
+struct dns_load_work
+{
+    struct dns_load_chunk *chunks;
+    size_t chunk_count;
+    size_t next_chunk;
+};
+
+/**
+ * Add a single textual name from a line to the chunk's table.
+ *
+ * chunk     : Pointer to the chunk being parsed.
+ * text      : Pointer to the textual name.
+ * text_size : The length of the textual name.
+ * address   : The address to answer with, INADDR_ANY for the default.
+ */
+static void dns_load_add_name(struct dns_load_chunk *chunk, const char *text, size_t text_size, in_addr_t address)
+{
+    uint8_t name[DNS_NAME_MAX_SIZE];
+    uint8_t name_size = dns_table_encode_name(text, text_size, name);
+    if (name_size == 0)
+    {
+        chunk->invalid++;
+        return;
+    }
+    if (!dns_table_insert(&chunk->table, name, name_size, dns_table_hash(name, name_size), address))
+    {
+        chunk->duplicates++;
+    }
+}
+
+/**
+ * Parse a single line of a list file, see dns_load_lists() for the format.
+ *
+ * chunk : Pointer to the chunk being parsed.
+ * line  : Pointer to the start of the line.
+ * size  : The length of the line, without its newline.
+ */
+static void dns_load_parse_line(struct dns_load_chunk *chunk, const char *line, size_t size)
+{
+    const char *comment = memchr(line, '#', size);
+    const char *end = comment ? comment : line + size;
+    const char *token = line;
+    bool first_token = true;
+    in_addr_t address = INADDR_ANY;
+
+    while (token < end)
+    {
+        // Skip the whitespace in front of the token, then find its end.
+        while (token < end && (*token == ' ' || *token == '\t' || *token == '\r'))
+        {
+            token++;
+        }
+        const char *token_end = token;
+        while (token_end < end && *token_end != ' ' && *token_end != '\t' && *token_end != '\r')
+        {
+            token_end++;
+        }
+        size_t token_size = token_end - token;
+        if (token_size == 0)
+        {
+            break;
+        }
+
+        // A leading address makes this a hosts entry, otherwise the line is
+        // a plain domain.
+        if (first_token)
+        {
+            char text[INET6_ADDRSTRLEN];
+            first_token = false;
+            if (token_size < sizeof(text))
+            {
+                memcpy(text, token, token_size);
+                text[token_size] = '\0';
+                struct in_addr parsed;
+                if (inet_pton(AF_INET, text, &parsed) == 1)
+                {
+                    address = parsed.s_addr;
+                    token = token_end;
+                    continue;
+                }
+                // Only A records are answered, so skip IPv6 hosts entries.
+                if (memchr(text, ':', token_size))
+                {
+                    return;
+                }
+            }
+        }
+        dns_load_add_name(chunk, token, token_size, address);
+        token = token_end;
+    }
+}
+
+/**
+ * Parsing thread, takes chunks from the shared work until none are left.
+ *
+ * argument : Pointer to the shared dns_load_work.
+ * returns  : NULL.
+ */
+static void *dns_load_worker(void *argument)
+{
+    struct dns_load_work *work = argument;
+    size_t index;
+    while ((index = __atomic_fetch_add(&work->next_chunk, 1, __ATOMIC_RELAXED)) < work->chunk_count)
+    {
+        struct dns_load_chunk *chunk = &work->chunks[index];
+        // Assume roughly 32 bytes per name to avoid growing the table.
+        dns_table_init(&chunk->table, chunk->size / 32);
+
+        const char *line = chunk->start;
+        const char *chunk_end = chunk->start + chunk->size;
+        while (line < chunk_end)
+        {
+            const char *newline = memchr(line, '\n', chunk_end - line);
+            const char *line_end = newline ? newline : chunk_end;
+            dns_load_parse_line(chunk, line, line_end - line);
+            line = line_end + 1;
+        }
+    }
+    return NULL;
+}
+
+void dns_load_lists(struct dns_table *table, char **paths, int path_count, int threads, struct dns_load_stats *stats)
+{
+    struct timespec start_time, end_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    memset(stats, 0, sizeof(*stats));
+
+    struct dns_load_work work = {0};
+    size_t chunk_capacity = 0;
+    void **mappings = calloc(path_count, sizeof(*mappings));
+    size_t *mapping_sizes = calloc(path_count, sizeof(*mapping_sizes));
+    if (mappings == NULL || mapping_sizes == NULL)
+    {
+        err(1, "calloc");
+    }
+
+    // Map every file and split it into chunks that end on a line boundary.
+    for (int file = 0; file < path_count; file++)
+    {
+        int descriptor = open(paths[file], O_RDONLY);
+        struct stat file_stat;
+        if (descriptor < 0 || fstat(descriptor, &file_stat))
+        {
+            err(1, "%s", paths[file]);
+        }
+        size_t size = file_stat.st_size;
+        stats->files++;
+        stats->bytes += size;
+        if (size == 0)
+        {
+            close(descriptor);
+            continue;
+        }
+        const char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (data == MAP_FAILED)
+        {
+            err(1, "mmap %s", paths[file]);
+        }
+        close(descriptor);
+        madvise((void *)data, size, MADV_SEQUENTIAL);
+        mappings[file] = (void *)data;
+        mapping_sizes[file] = size;
+
+        size_t position = 0;
+        while (position < size)
+        {
+            size_t end = position + DNS_LOADER_CHUNK_SIZE;
+            if (end >= size)
+            {
+                end = size;
+            }
+            else
+            {
+                const char *newline = memchr(data + end, '\n', size - end);
+                end = newline ? (size_t)(newline - data) + 1 : size;
+            }
+
+            if (work.chunk_count == chunk_capacity)
+            {
+                chunk_capacity = chunk_capacity ? chunk_capacity * 2 : 64;
+                work.chunks = realloc(work.chunks, chunk_capacity * sizeof(*work.chunks));
+                if (work.chunks == NULL)
+                {
+                    err(1, "realloc");
+                }
+            }
+            memset(&work.chunks[work.chunk_count], 0, sizeof(*work.chunks));
+            work.chunks[work.chunk_count].start = data + position;
+            work.chunks[work.chunk_count].size = end - position;
+            work.chunk_count++;
+            position = end;
+        }
+    }
+
+    // Parse the chunks on all cores.
+    if (threads <= 0)
+    {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if ((size_t)threads > work.chunk_count)
+    {
+        threads = work.chunk_count;
+    }
+    pthread_t *thread_ids = calloc(threads ? threads : 1, sizeof(*thread_ids));
+    if (thread_ids == NULL)
+    {
+        err(1, "calloc");
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        if (pthread_create(&thread_ids[i], NULL, dns_load_worker, &work))
+        {
+            errx(1, "Unable to start list loading thread");
+        }
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(thread_ids[i], NULL);
+    }
+    free(thread_ids);
+
+    // Merge the chunks in file order so the first occurrence of a name wins.
+    size_t expected = table->count;
+    size_t expected_names_size = table->names_size;
+    for (size_t i = 0; i < work.chunk_count; i++)
+    {
+        expected += work.chunks[i].table.count;
+        expected_names_size += work.chunks[i].table.names_size;
+    }
+    if (expected * 2 > table->capacity)
+    {
+        struct dns_table merged;
+        dns_table_init(&merged, expected);
+        for (size_t slot = 0; slot < table->capacity; slot++)
+        {
+            struct dns_table_entry *entry = &table->entries[slot];
+            if (entry->name_size)
+            {
+                dns_table_insert(&merged, table->names + entry->name_offset, entry->name_size, entry->hash, entry->address);
+            }
+        }
+        dns_table_free(table);
+        *table = merged;
+    }
+    if (expected_names_size > table->names_capacity)
+    {
+        table->names = realloc(table->names, expected_names_size);
+        if (table->names == NULL)
+        {
+            err(1, "realloc");
+        }
+        table->names_capacity = expected_names_size;
+    }
+    for (size_t i = 0; i < work.chunk_count; i++)
+    {
+        struct dns_load_chunk *chunk = &work.chunks[i];
+        for (size_t slot = 0; slot < chunk->table.capacity; slot++)
+        {
+            struct dns_table_entry *entry = &chunk->table.entries[slot];
+            if (entry->name_size && !dns_table_insert(table, chunk->table.names + entry->name_offset, entry->name_size, entry->hash, entry->address))
+            {
+                stats->duplicates++;
+            }
+        }
+        stats->duplicates += chunk->duplicates;
+        stats->invalid += chunk->invalid;
+        dns_table_free(&chunk->table);
+    }
+
+    for (int file = 0; file < path_count; file++)
+    {
+        if (mappings[file])
+        {
+            munmap(mappings[file], mapping_sizes[file]);
+        }
+    }
+    free(mappings);
+    free(mapping_sizes);
+    free(work.chunks);
+
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    stats->chunks = work.chunk_count;
+    stats->threads = threads;
+    stats->entries = table->count;
+    stats->seconds = (end_time.tv_sec - start_time.tv_sec) + (end_time.tv_nsec - start_time.tv_nsec) / 1e9;
+    stats->peak_memory_kb = usage.ru_maxrss;
+}
+
+void dns_load_print_stats(const struct dns_load_stats *stats, FILE *stream)
+{
+    double rate = stats->seconds > 0 ? stats->entries / stats->seconds : 0.0;
+    fprintf(stream, "lists: files=%zu bytes=%zu chunks=%zu threads=%zu entries=%zu duplicates=%zu invalid=%zu seconds=%.3f entries_per_second=%.0f peak_memory_kb=%ld\n",
+            stats->files, stats->bytes, stats->chunks, stats->threads, stats->entries, stats->duplicates, stats->invalid,
+            stats->seconds, rate, stats->peak_memory_kb);
+}
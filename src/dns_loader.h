@@ -0,0 +1,56 @@
+/**
+ * Contains a loader for large hosts-file and plain-domain lists. The files
+ * are memory-mapped, split into chunks on line boundaries, and parsed,
+ * normalized and deduplicated on all cores before the per-chunk results are
+ * merged into the final answer table.
+ */
+#ifndef DNS_LOADER_H
+#define DNS_LOADER_H
+#include <stddef.h>
+#include <stdio.h>
+
+#include "dns_table.h"
+
+// The target size of the chunks the list files are split into.
+#define DNS_LOADER_CHUNK_SIZE (4 * 1024 * 1024)
+
+/**
+ * Counters describing the cost of a load, reported at startup.
+ */
+struct dns_load_stats
+{
+    size_t files;
+    size_t bytes;
+    size_t chunks;
+    size_t threads;
+    size_t entries;
+    size_t duplicates;
+    size_t invalid;
+    double seconds;
+    long peak_memory_kb;
+};
+
+/**
+ * Load the given list files into the table. Each line holds either a hosts
+ * entry ("address name [name ...]") or a single domain name, and anything
+ * after a '#' is ignored. Plain domains and hosts entries for 0.0.0.0 are
+ * answered with the default address. When a name appears more than once, the
+ * first occurrence in file order wins.
+ *
+ * table      : Pointer to an initialized table to load into.
+ * paths      : The paths of the list files.
+ * path_count : The number of list files.
+ * threads    : The number of parsing threads, zero to use all cores.
+ * stats      : Filled with the counters of the load.
+ */
+void dns_load_lists(struct dns_table *table, char **paths, int path_count, int threads, struct dns_load_stats *stats);
+
+/**
+ * Print the counters of a load.
+ *
+ * stats  : Pointer to the counters to print.
+ * stream : The stream to print to.
+ */
+void dns_load_print_stats(const struct dns_load_stats *stats, FILE *stream);
+
+#endif // DNS_LOADER_H
@@ -10,7 +10,7 @@
 #include "dns_defns.h"
 #include "dns_manager.h"
 
-ssize_t add_answers(uint8_t *message, uint16_t message_qd, ssize_t message_size, char *default_adddress_response)
+ssize_t add_answers(uint8_t *message, uint16_t message_qd, ssize_t message_size, const struct dns_answer_policy *policy)
 {
     // The total response size, offset by the header.
     ssize_t response_size = DNS_HEADER_SIZE;
@@ -18,6 +18,16 @@ ssize_t add_answers(uint8_t *message, uint16_t message_qd, ssize_t message_size,
     // Keep track of the current position within the message.
     uint16_t positions[DNS_MAX_QUESTIONS];
 
+    // The address answered for each question, whether it is answered, and
+    // whether the answer comes from the policy's answer set.
+    in_addr_t addresses[DNS_MAX_QUESTIONS];
+    uint16_t types[DNS_MAX_QUESTIONS];
+    bool answered[DNS_MAX_QUESTIONS];
+    bool from_set[DNS_MAX_QUESTIONS];
+    uint16_t answer_count = 0;
+    uint8_t answered_count = 0;
+    bool truncate_any = false;
+
     // Go through all of the questions and update the response size accordingly.
     // Parsed based on information from RFC 1035 4.1.2.
     for (uint8_t question_number = 0; question_number < message_qd; question_number++)
@@ -34,13 +44,17 @@ ssize_t add_answers(uint8_t *message, uint16_t message_qd, ssize_t message_size,
         }
         response_size += name_size;
 
-        // Ensure that we support the question type.
+        // Ensure that we support the question type. AAAA questions are only
+        // supported when the answer set has IPv6 addresses.
         uint16_t question_type = ntohs(*(uint16_t *)(message + response_size));
-        if (question_type != DNS_RR_TYPE_ANY && question_type != DNS_RR_TYPE_A)
+        bool answers_aaaa = policy->answers && policy->answers->aaaa.count > 0;
+        if (question_type != DNS_RR_TYPE_ANY && question_type != DNS_RR_TYPE_A && (question_type != DNS_RR_TYPE_AAAA || !answers_aaaa))
         {
             set_not_implemented_flags(message);
             return message_size;
         }
+        types[question_number] = question_type;
+        truncate_any |= question_type == DNS_RR_TYPE_ANY && policy->any == DNS_ANY_TRUNCATE;
 
         // The next value is the question class, ensure we support that.
         uint16_t question_class = ntohs(*(uint16_t *)(message + response_size + sizeof(uint16_t)));
@@ -53,11 +67,90 @@ ssize_t add_answers(uint8_t *message, uint16_t message_qd, ssize_t message_size,
         // Add 32 bits to the response size to account for the question class
         // and type.
         response_size += sizeof(uint32_t);
+        if (truncate_any)
+        {
+            continue;
+        }
+
+        // Only answer names in the table or matching a pattern when either is
+        // loaded. Table entries without their own address, and patterns, use
+        // the default address, or the answer set when there is one.
+        addresses[question_number] = policy->address;
+        answered[question_number] = policy->table == NULL && policy->patterns == NULL;
+        from_set[question_number] = policy->answers != NULL;
+        if (policy->table)
+        {
+            in_addr_t table_address;
+            answered[question_number] = dns_table_lookup(policy->table, message + positions[question_number], &table_address);
+            if (answered[question_number] && table_address != INADDR_ANY)
+            {
+                addresses[question_number] = table_address;
+                from_set[question_number] = false;
+            }
+        }
+        if (!answered[question_number] && policy->patterns)
+        {
+            answered[question_number] = dns_pattern_match(policy->patterns, message + positions[question_number]);
+        }
+    }
+
+    // Send clients asking for ANY to TCP with an empty truncated reply,
+    // whatever the name, see RFC 8482 4.4.
+    if (truncate_any)
+    {
+        set_dns_ancount(message, 0);
+        set_dns_flags(message, get_dns_flags(message) | DNS_FLAG_TC);
+        return response_size;
     }
 
-    // Go through and add to the answers section, see RFC 1035 4.1.3.
+    // Go through and add to the answers section, see RFC 1035 4.1.3. Answers
+    // that do not fit in a UDP message are left out and the reply is marked
+    // as truncated, see RFC 1035 4.1.1.
     for (uint8_t answer_number = 0; answer_number < message_qd; answer_number++)
     {
+        if (!answered[answer_number])
+        {
+            continue;
+        }
+        answered_count++;
+
+        // A single synthesized record answers ANY, see RFC 8482 4.2.
+        if (types[answer_number] == DNS_RR_TYPE_ANY && policy->any == DNS_ANY_HINFO)
+        {
+            if (response_size + DNS_ANY_HINFO_SIZE > DNS_UDP_MAX_SIZE)
+            {
+                set_dns_flags(message, get_dns_flags(message) | DNS_FLAG_TC);
+                break;
+            }
+            dns_any_append_hinfo(positions[answer_number], message, &response_size);
+            answer_count++;
+            continue;
+        }
+
+        if (from_set[answer_number])
+        {
+            int records = dns_answer_append(policy->answers, types[answer_number], policy->rotation, positions[answer_number], message, &response_size);
+            if (records < 0)
+            {
+                set_dns_flags(message, get_dns_flags(message) | DNS_FLAG_TC);
+                break;
+            }
+            answer_count += records;
+            continue;
+        }
+
+        // A single address only answers for IPv4.
+        if (types[answer_number] == DNS_RR_TYPE_AAAA)
+        {
+            continue;
+        }
+        if (response_size + DNS_ANSWER_A_SIZE > DNS_UDP_MAX_SIZE)
+        {
+            set_dns_flags(message, get_dns_flags(message) | DNS_FLAG_TC);
+            break;
+        }
+        answer_count++;
+
         positions[answer_number] |= 0xC000; // First two bits should be one.
                                             // See RFC 1035 4.1.4.
 
@@ -76,16 +169,24 @@ ssize_t add_answers(uint8_t *message, uint16_t message_qd, ssize_t message_size,
 
         // Add the size of the address and the address itself.
         *(uint16_t *)(message + response_size) = htons(sizeof(in_addr_t));
-        *(in_addr_t *)(message + response_size + sizeof(uint16_t)) = inet_addr(default_adddress_response);
+        *(in_addr_t *)(message + response_size + sizeof(uint16_t)) = addresses[answer_number];
 
         // Add both of their sizes to the response size.
         response_size += sizeof(in_addr_t) + sizeof(uint16_t);
     }
+
+    // Set the DNS answer count, and report names we do not answer for as
+    // nonexistent.
+    set_dns_ancount(message, answer_count);
+    if (answered_count == 0)
+    {
+        set_name_error_flags(message);
+    }
     // Return the entire aggregated response size.
     return response_size;
 }
 
-ssize_t parse_message(uint8_t *message, ssize_t message_size, char *default_adddress_response)
+ssize_t parse_message(uint8_t *message, ssize_t message_size, const struct dns_answer_policy *policy)
 {
     // If the message is a response, drop it.
     if (get_dns_flags(message) & DNS_FLAG_QR)
@@ -116,17 +217,14 @@ ssize_t parse_message(uint8_t *message, ssize_t message_size, char *default_addd
         set_dns_arcount(message, 0);
     }
 
-    // Process each question, return the response length as its needed when
-    // calling sendto() to respond.
-    ssize_t response_size = add_answers(message, message_qd, message_size, default_adddress_response);
-
-    // Set the DNS answer to the number of questions asked.
-    set_dns_ancount(message, message_qd);
-
     // Set the default DNS flags associated with what this minimal
-    // implementation can actually support.
+    // implementation can actually support. This happens before the questions
+    // are processed so that any error they report is kept.
     set_default_dns_flags(message);
-    return response_size;
+
+    // Process each question, return the response length as its needed when
+    // calling sendto() to respond. This also sets the DNS answer count.
+    return add_answers(message, message_qd, message_size, policy);
 }
 
 void set_not_implemented_flags(uint8_t *message)
@@ -145,6 +243,14 @@ void set_format_error_flags(uint8_t *message)
     set_dns_flags(message, flags);
 }
 
+void set_name_error_flags(uint8_t *message)
+{
+    uint16_t flags = get_dns_flags(message);
+    flags &= ~DNS_FLAG_RCODE_MASK;
+    flags |= DNS_FLAG_RCODE_NAME_ERROR | DNS_FLAG_QR;
+    set_dns_flags(message, flags);
+}
+
 void set_default_dns_flags(uint8_t *message)
 {
     // Defaults from assignment.
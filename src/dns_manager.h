@@ -15,14 +15,39 @@
 #include <sys/types.h>
 #include <stdint.h>
 
+#include "dns_answer.h"
+#include "dns_any.h"
+#include "dns_pattern.h"
+#include "dns_table.h"
+
 /**
- * Set the non-implemented flags in the given message. Modifies the message
- * in place.
+ * Describes how questions are answered.
+ */
+struct dns_answer_policy
+{
+    in_addr_t address;             // The default address, in network byte order.
+    const struct dns_table *table; // Names to answer for, or NULL to answer every name.
+    const struct dns_pattern_dfa *patterns; // Name patterns to answer for, or NULL.
+    const struct dns_answer_set *answers;   // Addresses to rotate over in place of the default, or NULL.
+    uint32_t rotation;                      // The rotation slot of this query, ignored without a set.
+    enum dns_any_mode any;                  // How ANY questions are answered.
+};
+
+/**
+ * Validate the questions of the message and append an answer for each one the
+ * policy answers for. Sets the answer count, the name error flags if no
+ * question is answered, and the truncation flag if the answers do not fit in
+ * a UDP message. ANY questions are answered as the policy's ANY mode says, and
+ * with DNS_ANY_TRUNCATE the reply holds no answers at all. Modifies the
+ * message in place.
  * 
- * message : Pointer to the message to set the non-implemented flags for.
- * returns : Void, modifies the message in place.
+ * message      : Pointer to the message to add answers to.
+ * message_qd   : The number of questions in the message.
+ * message_size : Size of the incoming message.
+ * policy       : The policy deciding which address each question is answered with.
+ * returns      : Size of the response.
  */
-ssize_t add_answers(uint8_t *message, uint16_t message_qd, ssize_t message_size, char *default_adddress_response);
+ssize_t add_answers(uint8_t *message, uint16_t message_qd, ssize_t message_size, const struct dns_answer_policy *policy);
 
 /** 
  * Process incoming messages. If the received message is valid,
@@ -30,9 +55,11 @@ ssize_t add_answers(uint8_t *message, uint16_t message_qd, ssize_t message_size,
  * match that response, and then send it.
  * 
  * message : Pointer to the incoming message.
+ * message_size : Size of the incoming message.
+ * policy  : The policy deciding which address each question is answered with.
  * returns : Size of new message. Message itself modified in place.
  */
-ssize_t parse_message(uint8_t *message, ssize_t message_size, char *default_adddress_response);
+ssize_t parse_message(uint8_t *message, ssize_t message_size, const struct dns_answer_policy *policy);
 
 /**
  * Set the non-implemented flags in the given message. Modifies the message
@@ -52,6 +79,15 @@ void set_not_implemented_flags(uint8_t *message);
  */
 void set_format_error_flags(uint8_t *message);
 
+/**
+ * Set the flags to indicate the queried name does not exist. Modifies the
+ * message in place.
+ * 
+ * message : Pointer to the message to set the name error flags for.
+ * returns : Void, modifies the message in place. 
+ */
+void set_name_error_flags(uint8_t *message);
+
 /**
  * Set the DNS flags to default values for a valid response.
  * 
@@ -0,0 +1,115 @@
+/**
+ * DNS Overload
+ * Contains implementation of the overload controller and its cheap load
+ * shedding path.
+*/
+
+#include <inttypes.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <linux/sock_diag.h>
+
+#include "dns_defns.h"
+#include "dns_manager.h"
+#include "dns_overload.h"
+
+void dns_overload_init(struct dns_overload *overload, enum dns_overload_action action)
+{
+    memset(overload, 0, sizeof(*overload));
+    overload->action = action;
+    overload->queries_until_check = DNS_OVERLOAD_CHECK_INTERVAL;
+}
+
+void dns_overload_record_latency(struct dns_overload *overload, uint64_t latency_ns)
+{
+    // Exponentially weighted moving average with a weight of 1/8.
+    overload->latency_ns = overload->latency_ns - overload->latency_ns / 8 + latency_ns / 8;
+}
+
+bool dns_overload_check(struct dns_overload *overload, int socket)
+{
+    if (--overload->queries_until_check > 0)
+    {
+        return overload->degraded;
+    }
+    overload->queries_until_check = DNS_OVERLOAD_CHECK_INTERVAL;
+
+    // Sample how full the receive buffer is, see SO_MEMINFO in socket(7).
+    uint32_t meminfo[SK_MEMINFO_VARS];
+    socklen_t meminfo_size = sizeof(meminfo);
+    if (getsockopt(socket, SOL_SOCKET, SO_MEMINFO, meminfo, &meminfo_size) == 0 && meminfo[SK_MEMINFO_RCVBUF] > 0)
+    {
+        overload->backlog_percent = (uint64_t)meminfo[SK_MEMINFO_RMEM_ALLOC] * 100 / meminfo[SK_MEMINFO_RCVBUF];
+    }
+
+    if (!overload->degraded)
+    {
+        if (overload->backlog_percent >= DNS_OVERLOAD_HIGH_BACKLOG || overload->latency_ns >= DNS_OVERLOAD_HIGH_LATENCY_NS)
+        {
+            overload->degraded = true;
+            overload->calm_checks = 0;
+            overload->transitions++;
+            fprintf(stderr, "Overloaded (backlog %" PRIu32 "%%, latency %" PRIu64 " ns), shedding load\n", overload->backlog_percent, overload->latency_ns);
+        }
+        return overload->degraded;
+    }
+
+    // The full path is not measured while degraded, so only the backlog
+    // decides when to return to normal.
+    if (overload->backlog_percent > DNS_OVERLOAD_LOW_BACKLOG)
+    {
+        overload->calm_checks = 0;
+    }
+    else if (++overload->calm_checks >= DNS_OVERLOAD_CALM_CHECKS)
+    {
+        overload->degraded = false;
+        overload->latency_ns = 0;
+        overload->transitions++;
+        fprintf(stderr, "Load back to normal after shedding %" PRIu64 " queries\n", overload->shed);
+    }
+    return overload->degraded;
+}
+
+ssize_t dns_overload_shed(struct dns_overload *overload, uint8_t *message, ssize_t message_size)
+{
+    overload->shed++;
+    uint16_t flags = get_dns_flags(message);
+    if (overload->action == DNS_OVERLOAD_DROP || (flags & DNS_FLAG_QR))
+    {
+        return 0;
+    }
+
+    // Echo a single question if it is well formed, otherwise reply with the
+    // header alone.
+    ssize_t response_size = DNS_HEADER_SIZE;
+    uint16_t question_count = 0;
+    if (get_dns_qdcount(message) == 1)
+    {
+        ssize_t name_end = DNS_HEADER_SIZE;
+        while (name_end < message_size && message[name_end] > 0 && message[name_end] <= DNS_LABEL_MAX_SIZE)
+        {
+            name_end += message[name_end] + 1;
+        }
+        // The terminating zero label is followed by the type and class.
+        ssize_t question_end = name_end + 1 + 2 * sizeof(uint16_t);
+        if (question_end <= message_size && message[name_end] == 0)
+        {
+            response_size = question_end;
+            question_count = 1;
+        }
+    }
+
+    set_dns_flags(message, (flags & (DNS_FLAG_OPCODE | DNS_FLAG_RD)) | DNS_FLAG_QR | DNS_FLAG_RCODE_REFUSED);
+    set_dns_qdcount(message, question_count);
+    set_dns_ancount(message, 0);
+    set_dns_nscount(message, 0);
+    set_dns_arcount(message, 0);
+    return response_size;
+}
+
+void dns_overload_print_stats(const struct dns_overload *overload, FILE *stream)
+{
+    fprintf(stream, "overload: state=%s action=%s backlog=%" PRIu32 "%% latency_ns=%" PRIu64 " transitions=%" PRIu64 " shed=%" PRIu64 "\n",
+            overload->degraded ? "degraded" : "normal", overload->action == DNS_OVERLOAD_DROP ? "drop" : "refuse",
+            overload->backlog_percent, overload->latency_ns, overload->transitions, overload->shed);
+}
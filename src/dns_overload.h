@@ -0,0 +1,101 @@
+/**
+ * Contains an overload controller that watches the receive backlog of the
+ * socket and the processing latency of the loop. Above a threshold it
+ * switches to a degraded mode that sheds load with a minimal REFUSED reply
+ * (or by dropping queries) instead of running the full parse_message() path,
+ * and it only returns to normal once the backlog has stayed low for a while.
+ */
+#ifndef DNS_OVERLOAD_H
+#define DNS_OVERLOAD_H
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// The number of queries between two samples of the receive backlog.
+#define DNS_OVERLOAD_CHECK_INTERVAL 32
+
+// Receive backlog thresholds, as a percentage of the receive buffer.
+#define DNS_OVERLOAD_HIGH_BACKLOG 75
+#define DNS_OVERLOAD_LOW_BACKLOG 25
+
+// Average processing latency per query above which load is shed.
+#define DNS_OVERLOAD_HIGH_LATENCY_NS 200000
+
+// The number of consecutive calm samples before returning to normal.
+#define DNS_OVERLOAD_CALM_CHECKS 8
+
+/**
+ * How queries are handled in degraded mode.
+ */
+enum dns_overload_action
+{
+    DNS_OVERLOAD_REFUSE, // Answer with a minimal REFUSED reply.
+    DNS_OVERLOAD_DROP,   // Drop the query without answering.
+};
+
+/**
+ * The state of the controller for a single processing loop.
+ */
+struct dns_overload
+{
+    enum dns_overload_action action;
+    bool degraded;
+    uint32_t queries_until_check;
+    uint32_t calm_checks;
+
+    // Latest samples.
+    uint32_t backlog_percent;
+    uint64_t latency_ns; // Moving average of the full processing path.
+
+    // Counters exposed in the statistics.
+    uint64_t transitions;
+    uint64_t shed;
+};
+
+/**
+ * Reset the controller to normal mode and clear its counters.
+ *
+ * overload : Pointer to the controller to initialize.
+ * action   : How queries are handled in degraded mode.
+ */
+void dns_overload_init(struct dns_overload *overload, enum dns_overload_action action);
+
+/**
+ * Record the processing latency of a query that ran the full path.
+ *
+ * overload   : Pointer to the controller to update.
+ * latency_ns : The time taken to process and answer the query.
+ */
+void dns_overload_record_latency(struct dns_overload *overload, uint64_t latency_ns);
+
+/**
+ * Account for a received query and, every DNS_OVERLOAD_CHECK_INTERVAL
+ * queries, sample the receive backlog and update the mode.
+ *
+ * overload : Pointer to the controller to update.
+ * socket   : The socket the query was received on.
+ * returns  : True if the query should be shed with dns_overload_shed().
+ */
+bool dns_overload_check(struct dns_overload *overload, int socket);
+
+/**
+ * Shed a query. Builds a minimal REFUSED reply in place, echoing a single
+ * question if present, without validating the message.
+ *
+ * overload     : Pointer to the controller to update.
+ * message      : Pointer to the incoming query.
+ * message_size : Size of the incoming query.
+ * returns      : Size of the reply, zero if the query is dropped.
+ */
+ssize_t dns_overload_shed(struct dns_overload *overload, uint8_t *message, ssize_t message_size);
+
+/**
+ * Print the state and counters of the controller.
+ *
+ * overload : Pointer to the controller to report on.
+ * stream   : The stream to print to.
+ */
+void dns_overload_print_stats(const struct dns_overload *overload, FILE *stream);
+
+#endif // DNS_OVERLOAD_H
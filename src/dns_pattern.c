@@ -0,0 +1,1001 @@
+/**
+ * DNS Pattern
+ * Contains implementation of compiling wildcard name patterns into a
+ * minimized DFA and of matching names with it. Patterns are compiled in
+ * batches with the subset construction over pattern positions, each batch is
+ * minimized with Moore's partition refinement, and the batches are then
+ * joined pairwise with the product construction, minimizing after each join.
+ * Joining minimized DFAs keeps the intermediate DFAs small, whereas a single
+ * subset construction over every pattern can blow up when patterns mix '*'
+ * and '**'.
+*/
+
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dns_defns.h"
+#include "dns_pattern.h"
+
+// Marks an empty slot of a hash index.
+#define DNS_PATTERN_EMPTY UINT32_MAX
+
+// Detects a compiled DFA written on a machine of different byte order.
+#define DNS_PATTERN_BYTE_ORDER 0x01020304u
+
+/**
+ * The kinds of pattern positions.
+ */
+enum dns_pattern_token
+{
+    DNS_PATTERN_LITERAL,   // A single character, matched by its class.
+    DNS_PATTERN_SEPARATOR, // The boundary between two labels.
+    DNS_PATTERN_ANY,       // '?', any single character within a label.
+    DNS_PATTERN_STAR,      // '*', any run of characters within a label.
+    DNS_PATTERN_GLOBSTAR,  // '**', any run of characters across labels.
+    DNS_PATTERN_END,       // The end of a pattern, where it matches.
+};
+
+/**
+ * Working state of the subset construction for a batch. Every DFA state is
+ * the set of pattern positions reachable after reading some input, stored as
+ * a sorted list.
+ */
+struct dns_pattern_builder
+{
+    // The positions of all patterns of the batch, back to back.
+    uint8_t *kinds;
+    uint8_t *classes;
+    size_t position_count;
+
+    // The position sets of the DFA states, stored back to back in the pool.
+    uint32_t *pool;
+    size_t pool_size;
+    size_t pool_capacity;
+    size_t *set_offsets;
+    uint32_t *set_sizes;
+    uint32_t *set_hashes;
+    size_t state_capacity;
+    uint32_t state_count;
+
+    // Hash index from position sets to states.
+    uint32_t *index;
+    size_t index_capacity;
+
+    // The set being built, deduplicated with a generation stamp per position.
+    uint32_t *scratch;
+    size_t scratch_size;
+    uint32_t *stamps;
+    uint32_t generation;
+
+    // The DFA being built.
+    uint32_t class_count;
+    uint32_t separator_class;
+    uint32_t *transitions;
+    bool *accept;
+};
+
+/**
+ * Grow an array to hold at least the needed number of elements.
+ *
+ * array        : The array to grow.
+ * capacity     : Pointer to the capacity of the array, updated.
+ * needed       : The number of elements needed.
+ * element_size : The size of a single element.
+ * returns      : The grown array.
+ */
+static void *dns_pattern_grow(void *array, size_t *capacity, size_t needed, size_t element_size)
+{
+    if (needed <= *capacity)
+    {
+        return array;
+    }
+    size_t new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < needed)
+    {
+        new_capacity *= 2;
+    }
+    array = realloc(array, new_capacity * element_size);
+    if (array == NULL)
+    {
+        err(1, "realloc");
+    }
+    *capacity = new_capacity;
+    return array;
+}
+
+/**
+ * Allocate the transitions and accepting flags of a DFA.
+ */
+static void dns_pattern_allocate(struct dns_pattern_dfa *dfa, uint32_t state_count)
+{
+    dfa->state_count = state_count;
+    dfa->transitions = malloc((size_t)state_count * dfa->class_count * sizeof(uint32_t));
+    dfa->accept = malloc(state_count * sizeof(bool));
+    if (dfa->transitions == NULL || dfa->accept == NULL)
+    {
+        err(1, "malloc");
+    }
+}
+
+/**
+ * Lowercase a single ASCII character.
+ */
+static inline uint8_t dns_pattern_lowercase(uint8_t value)
+{
+    return (value >= 'A' && value <= 'Z') ? value | 0x20 : value;
+}
+
+/**
+ * Find the length of a pattern, without a trailing dot.
+ */
+static size_t dns_pattern_length(const char *pattern)
+{
+    size_t length = strlen(pattern);
+    if (length > 0 && pattern[length - 1] == '.')
+    {
+        length--;
+    }
+    return length;
+}
+
+/**
+ * Assign a symbol class to every character used in the patterns. All other
+ * characters share class zero, and the separator takes the last class.
+ */
+static void dns_pattern_assign_classes(struct dns_pattern_dfa *dfa, char **patterns, size_t count)
+{
+    bool used[256] = {false};
+    for (size_t pattern = 0; pattern < count; pattern++)
+    {
+        size_t length = dns_pattern_length(patterns[pattern]);
+        for (size_t i = 0; i < length; i++)
+        {
+            uint8_t value = dns_pattern_lowercase(patterns[pattern][i]);
+            if (value != '*' && value != '?' && value != '.')
+            {
+                used[value] = true;
+            }
+        }
+    }
+
+    uint32_t class_count = 1;
+    memset(dfa->class_map, 0, sizeof(dfa->class_map));
+    for (int value = 0; value < 256; value++)
+    {
+        if (used[value])
+        {
+            dfa->class_map[value] = class_count++;
+        }
+    }
+    // Upper case letters share the class of their lower case letter.
+    for (int value = 'A'; value <= 'Z'; value++)
+    {
+        dfa->class_map[value] = dfa->class_map[value | 0x20];
+    }
+    dfa->separator_class = class_count;
+    dfa->class_count = class_count + 1;
+}
+
+/**
+ * Turn the patterns into positions, one per character plus an end position.
+ */
+static void dns_pattern_tokenize(struct dns_pattern_builder *builder, const struct dns_pattern_dfa *dfa, char **patterns, size_t count)
+{
+    size_t total = 0;
+    for (size_t pattern = 0; pattern < count; pattern++)
+    {
+        total += dns_pattern_length(patterns[pattern]) + 1;
+    }
+    builder->kinds = malloc(total + 1);
+    builder->classes = malloc(total + 1);
+    builder->stamps = calloc(total + 1, sizeof(uint32_t));
+    if (builder->kinds == NULL || builder->classes == NULL || builder->stamps == NULL)
+    {
+        err(1, "malloc");
+    }
+
+    size_t position = 0;
+    for (size_t pattern = 0; pattern < count; pattern++)
+    {
+        const char *text = patterns[pattern];
+        size_t length = dns_pattern_length(text);
+        for (size_t i = 0; i < length; i++, position++)
+        {
+            builder->classes[position] = 0;
+            if (text[i] == '*' && i + 1 < length && text[i + 1] == '*')
+            {
+                builder->kinds[position] = DNS_PATTERN_GLOBSTAR;
+                i++;
+            }
+            else if (text[i] == '*')
+            {
+                builder->kinds[position] = DNS_PATTERN_STAR;
+            }
+            else if (text[i] == '?')
+            {
+                builder->kinds[position] = DNS_PATTERN_ANY;
+            }
+            else if (text[i] == '.')
+            {
+                builder->kinds[position] = DNS_PATTERN_SEPARATOR;
+            }
+            else
+            {
+                builder->kinds[position] = DNS_PATTERN_LITERAL;
+                builder->classes[position] = dfa->class_map[(uint8_t)text[i]];
+            }
+        }
+        builder->kinds[position] = DNS_PATTERN_END;
+        builder->classes[position] = 0;
+        position++;
+    }
+    builder->position_count = position;
+}
+
+/**
+ * Add a position to the set being built, along with the positions after any
+ * stars it starts, since a star may match nothing.
+ */
+static void dns_pattern_add_position(struct dns_pattern_builder *builder, uint32_t position)
+{
+    while (builder->stamps[position] != builder->generation)
+    {
+        builder->stamps[position] = builder->generation;
+        builder->scratch[builder->scratch_size++] = position;
+        if (builder->kinds[position] != DNS_PATTERN_STAR && builder->kinds[position] != DNS_PATTERN_GLOBSTAR)
+        {
+            break;
+        }
+        position++;
+    }
+}
+
+/**
+ * Start building a new set of positions.
+ */
+static void dns_pattern_begin_set(struct dns_pattern_builder *builder)
+{
+    builder->generation++;
+    builder->scratch_size = 0;
+}
+
+/**
+ * Order positions, used with qsort() to make sets canonical.
+ */
+static int dns_pattern_compare_positions(const void *left, const void *right)
+{
+    uint32_t left_position = *(const uint32_t *)left;
+    uint32_t right_position = *(const uint32_t *)right;
+    return (left_position > right_position) - (left_position < right_position);
+}
+
+/**
+ * Hash a list of 32 bit values with FNV-1a.
+ */
+static uint32_t dns_pattern_hash(const uint32_t *values, size_t count)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < count; i++)
+    {
+        hash ^= values[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Rebuild the state index with twice the capacity.
+ */
+static void dns_pattern_grow_index(struct dns_pattern_builder *builder)
+{
+    free(builder->index);
+    builder->index_capacity = builder->index_capacity ? builder->index_capacity * 2 : 1024;
+    builder->index = malloc(builder->index_capacity * sizeof(uint32_t));
+    if (builder->index == NULL)
+    {
+        err(1, "malloc");
+    }
+    memset(builder->index, 0xFF, builder->index_capacity * sizeof(uint32_t));
+    for (uint32_t state = 0; state < builder->state_count; state++)
+    {
+        size_t slot = builder->set_hashes[state] & (builder->index_capacity - 1);
+        while (builder->index[slot] != DNS_PATTERN_EMPTY)
+        {
+            slot = (slot + 1) & (builder->index_capacity - 1);
+        }
+        builder->index[slot] = state;
+    }
+}
+
+/**
+ * Find the state for the set being built, creating it if it is new.
+ *
+ * returns : The state of the set.
+ */
+static uint32_t dns_pattern_intern(struct dns_pattern_builder *builder)
+{
+    qsort(builder->scratch, builder->scratch_size, sizeof(uint32_t), dns_pattern_compare_positions);
+    uint32_t hash = dns_pattern_hash(builder->scratch, builder->scratch_size);
+
+    size_t slot = hash & (builder->index_capacity - 1);
+    for (; builder->index[slot] != DNS_PATTERN_EMPTY; slot = (slot + 1) & (builder->index_capacity - 1))
+    {
+        uint32_t state = builder->index[slot];
+        if (builder->set_hashes[state] == hash && builder->set_sizes[state] == builder->scratch_size &&
+            memcmp(builder->pool + builder->set_offsets[state], builder->scratch, builder->scratch_size * sizeof(uint32_t)) == 0)
+        {
+            return state;
+        }
+    }
+
+    uint32_t state = builder->state_count++;
+    if (state >= DNS_PATTERN_MAX_STATES)
+    {
+        errx(1, "Patterns need more than %d DFA states", DNS_PATTERN_MAX_STATES);
+    }
+
+    // Store the set and reserve the row of transitions for the new state.
+    size_t capacity = builder->state_capacity;
+    builder->set_offsets = dns_pattern_grow(builder->set_offsets, &capacity, state + 1, sizeof(size_t));
+    capacity = builder->state_capacity;
+    builder->set_sizes = dns_pattern_grow(builder->set_sizes, &capacity, state + 1, sizeof(uint32_t));
+    capacity = builder->state_capacity;
+    builder->set_hashes = dns_pattern_grow(builder->set_hashes, &capacity, state + 1, sizeof(uint32_t));
+    capacity = builder->state_capacity;
+    builder->accept = dns_pattern_grow(builder->accept, &capacity, state + 1, sizeof(bool));
+    if (capacity > builder->state_capacity)
+    {
+        builder->transitions = realloc(builder->transitions, capacity * builder->class_count * sizeof(uint32_t));
+        if (builder->transitions == NULL)
+        {
+            err(1, "realloc");
+        }
+        builder->state_capacity = capacity;
+    }
+    builder->pool = dns_pattern_grow(builder->pool, &builder->pool_capacity, builder->pool_size + builder->scratch_size + 1, sizeof(uint32_t));
+    memcpy(builder->pool + builder->pool_size, builder->scratch, builder->scratch_size * sizeof(uint32_t));
+    builder->set_offsets[state] = builder->pool_size;
+    builder->set_sizes[state] = builder->scratch_size;
+    builder->set_hashes[state] = hash;
+    builder->pool_size += builder->scratch_size;
+
+    // The state accepts if it holds the end of a pattern.
+    builder->accept[state] = false;
+    for (size_t i = 0; i < builder->scratch_size; i++)
+    {
+        if (builder->kinds[builder->scratch[i]] == DNS_PATTERN_END)
+        {
+            builder->accept[state] = true;
+        }
+    }
+
+    builder->index[slot] = state;
+    if (builder->state_count * 2 > builder->index_capacity)
+    {
+        dns_pattern_grow_index(builder);
+    }
+    return state;
+}
+
+/**
+ * Build the transitions of every state with the subset construction.
+ */
+static void dns_pattern_build_states(struct dns_pattern_builder *builder, size_t pattern_count)
+{
+    builder->scratch = malloc((builder->position_count + 1) * sizeof(uint32_t));
+    if (builder->scratch == NULL)
+    {
+        err(1, "malloc");
+    }
+    dns_pattern_grow_index(builder);
+
+    // The empty set is the dead state, and every pattern starts at its first
+    // position in the start state.
+    dns_pattern_begin_set(builder);
+    dns_pattern_intern(builder);
+    dns_pattern_begin_set(builder);
+    for (size_t position = 0, pattern = 0; pattern < pattern_count; position++)
+    {
+        if (position == 0 || builder->kinds[position - 1] == DNS_PATTERN_END)
+        {
+            dns_pattern_add_position(builder, position);
+            pattern++;
+        }
+    }
+    dns_pattern_intern(builder);
+
+    for (uint32_t state = 0; state < builder->state_count; state++)
+    {
+        for (uint32_t symbol = 0; symbol < builder->class_count; symbol++)
+        {
+            bool separator = symbol == builder->separator_class;
+            dns_pattern_begin_set(builder);
+            // The pool may move while interning, so index it every time.
+            for (uint32_t i = 0; i < builder->set_sizes[state]; i++)
+            {
+                uint32_t position = builder->pool[builder->set_offsets[state] + i];
+                switch (builder->kinds[position])
+                {
+                case DNS_PATTERN_LITERAL:
+                    if (!separator && builder->classes[position] == symbol)
+                    {
+                        dns_pattern_add_position(builder, position + 1);
+                    }
+                    break;
+                case DNS_PATTERN_SEPARATOR:
+                    if (separator)
+                    {
+                        dns_pattern_add_position(builder, position + 1);
+                    }
+                    break;
+                case DNS_PATTERN_ANY:
+                    if (!separator)
+                    {
+                        dns_pattern_add_position(builder, position + 1);
+                    }
+                    break;
+                case DNS_PATTERN_STAR:
+                    if (!separator)
+                    {
+                        dns_pattern_add_position(builder, position);
+                    }
+                    break;
+                case DNS_PATTERN_GLOBSTAR:
+                    dns_pattern_add_position(builder, position);
+                    break;
+                default:
+                    break;
+                }
+            }
+            uint32_t next = dns_pattern_intern(builder);
+            builder->transitions[(size_t)state * builder->class_count + symbol] = next;
+        }
+    }
+}
+
+/**
+ * Compile a batch of patterns into an unminimized DFA, whose state zero is
+ * the dead state and state one the start state (or the dead state again if
+ * the batch is empty).
+ *
+ * dfa       : Pointer to the DFA to fill in.
+ * patterns  : The textual patterns of the batch.
+ * count     : The number of patterns in the batch.
+ * positions : Pointer to the count of pattern positions, increased.
+ */
+static void dns_pattern_build_batch(struct dns_pattern_dfa *dfa, char **patterns, size_t count, size_t *positions)
+{
+    struct dns_pattern_builder builder;
+    memset(&builder, 0, sizeof(builder));
+    dns_pattern_assign_classes(dfa, patterns, count);
+    builder.class_count = dfa->class_count;
+    builder.separator_class = dfa->separator_class;
+    dns_pattern_tokenize(&builder, dfa, patterns, count);
+    dns_pattern_build_states(&builder, count);
+    *positions += builder.position_count;
+
+    dfa->state_count = builder.state_count;
+    dfa->transitions = builder.transitions;
+    dfa->accept = builder.accept;
+
+    free(builder.kinds);
+    free(builder.classes);
+    free(builder.pool);
+    free(builder.set_offsets);
+    free(builder.set_sizes);
+    free(builder.set_hashes);
+    free(builder.index);
+    free(builder.scratch);
+    free(builder.stamps);
+}
+
+/**
+ * The pairs of states of a product construction, numbered in the order they
+ * are reached and found through an open addressing index.
+ */
+struct dns_pattern_pairs
+{
+    uint32_t *states; // The left and right state of each pair.
+    size_t capacity;
+    uint32_t count;
+    uint32_t *index;
+    size_t index_capacity;
+};
+
+/**
+ * Rebuild the pair index with the given capacity.
+ */
+static void dns_pattern_index_pairs(struct dns_pattern_pairs *pairs, size_t capacity)
+{
+    free(pairs->index);
+    pairs->index_capacity = capacity;
+    pairs->index = malloc(capacity * sizeof(uint32_t));
+    if (pairs->index == NULL)
+    {
+        err(1, "malloc");
+    }
+    memset(pairs->index, 0xFF, capacity * sizeof(uint32_t));
+    for (uint32_t state = 0; state < pairs->count; state++)
+    {
+        size_t slot = dns_pattern_hash(pairs->states + 2 * state, 2) & (capacity - 1);
+        while (pairs->index[slot] != DNS_PATTERN_EMPTY)
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        pairs->index[slot] = state;
+    }
+}
+
+/**
+ * Find the state for a pair of states, creating it if it is new.
+ *
+ * returns : The state of the pair.
+ */
+static uint32_t dns_pattern_intern_pair(struct dns_pattern_pairs *pairs, uint32_t left, uint32_t right)
+{
+    uint32_t key[2] = {left, right};
+    size_t slot = dns_pattern_hash(key, 2) & (pairs->index_capacity - 1);
+    for (; pairs->index[slot] != DNS_PATTERN_EMPTY; slot = (slot + 1) & (pairs->index_capacity - 1))
+    {
+        uint32_t state = pairs->index[slot];
+        if (pairs->states[2 * state] == left && pairs->states[2 * state + 1] == right)
+        {
+            return state;
+        }
+    }
+
+    uint32_t state = pairs->count++;
+    if (state >= DNS_PATTERN_MAX_STATES)
+    {
+        errx(1, "Patterns need more than %d DFA states", DNS_PATTERN_MAX_STATES);
+    }
+    pairs->states = dns_pattern_grow(pairs->states, &pairs->capacity, 2 * (state + 1), sizeof(uint32_t));
+    pairs->states[2 * state] = left;
+    pairs->states[2 * state + 1] = right;
+    pairs->index[slot] = state;
+    if (pairs->count * 2 > pairs->index_capacity)
+    {
+        dns_pattern_index_pairs(pairs, pairs->index_capacity * 2);
+    }
+    return state;
+}
+
+/**
+ * Join two DFAs into one matching the names either matches, with the product
+ * construction over the pairs of states reachable from the start states.
+ *
+ * dfa   : Pointer to the unminimized DFA to fill in.
+ * left  : Pointer to the first DFA to join.
+ * right : Pointer to the second DFA to join.
+ */
+static void dns_pattern_join(struct dns_pattern_dfa *dfa, const struct dns_pattern_dfa *left, const struct dns_pattern_dfa *right)
+{
+    // A symbol class for every pair of classes some byte falls in, plus the
+    // pair of separators.
+    size_t class_pairs = (size_t)left->class_count * right->class_count;
+    uint32_t *pair_classes = malloc(class_pairs * sizeof(uint32_t));
+    uint32_t left_classes[257];
+    uint32_t right_classes[257];
+    if (pair_classes == NULL)
+    {
+        err(1, "malloc");
+    }
+    memset(pair_classes, 0xFF, class_pairs * sizeof(uint32_t));
+    uint32_t class_count = 0;
+    for (int value = 0; value < 256; value++)
+    {
+        size_t pair = (size_t)left->class_map[value] * right->class_count + right->class_map[value];
+        if (pair_classes[pair] == DNS_PATTERN_EMPTY)
+        {
+            left_classes[class_count] = left->class_map[value];
+            right_classes[class_count] = right->class_map[value];
+            pair_classes[pair] = class_count++;
+        }
+        dfa->class_map[value] = pair_classes[pair];
+    }
+    left_classes[class_count] = left->separator_class;
+    right_classes[class_count] = right->separator_class;
+    dfa->separator_class = class_count;
+    dfa->class_count = class_count + 1;
+    free(pair_classes);
+
+    struct dns_pattern_pairs pairs;
+    memset(&pairs, 0, sizeof(pairs));
+    dns_pattern_index_pairs(&pairs, 1024);
+    dns_pattern_intern_pair(&pairs, DNS_PATTERN_DEAD_STATE, DNS_PATTERN_DEAD_STATE);
+    dns_pattern_intern_pair(&pairs, DNS_PATTERN_START_STATE, DNS_PATTERN_START_STATE);
+
+    uint32_t *transitions = NULL;
+    size_t transition_capacity = 0;
+    for (uint32_t state = 0; state < pairs.count; state++)
+    {
+        transitions = dns_pattern_grow(transitions, &transition_capacity, (size_t)(state + 1) * dfa->class_count, sizeof(uint32_t));
+        for (uint32_t symbol = 0; symbol < dfa->class_count; symbol++)
+        {
+            // The pair array may move while interning, so index it every time.
+            uint32_t left_next = left->transitions[(size_t)pairs.states[2 * state] * left->class_count + left_classes[symbol]];
+            uint32_t right_next = right->transitions[(size_t)pairs.states[2 * state + 1] * right->class_count + right_classes[symbol]];
+            transitions[(size_t)state * dfa->class_count + symbol] = dns_pattern_intern_pair(&pairs, left_next, right_next);
+        }
+    }
+
+    dns_pattern_allocate(dfa, pairs.count);
+    memcpy(dfa->transitions, transitions, (size_t)pairs.count * dfa->class_count * sizeof(uint32_t));
+    for (uint32_t state = 0; state < pairs.count; state++)
+    {
+        dfa->accept[state] = left->accept[pairs.states[2 * state]] || right->accept[pairs.states[2 * state + 1]];
+    }
+    free(transitions);
+    free(pairs.states);
+    free(pairs.index);
+}
+
+/**
+ * Check whether two states belong to the same block and move to the same
+ * blocks on every symbol.
+ */
+static bool dns_pattern_equivalent(const struct dns_pattern_dfa *dfa, const uint32_t *blocks, uint32_t left, uint32_t right)
+{
+    if (blocks[left] != blocks[right])
+    {
+        return false;
+    }
+    const uint32_t *left_row = dfa->transitions + (size_t)left * dfa->class_count;
+    const uint32_t *right_row = dfa->transitions + (size_t)right * dfa->class_count;
+    for (uint32_t symbol = 0; symbol < dfa->class_count; symbol++)
+    {
+        if (blocks[left_row[symbol]] != blocks[right_row[symbol]])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Merge equivalent states with Moore's partition refinement, and write the
+ * minimized DFA with the dead and start states first.
+ *
+ * dfa     : Pointer to the minimized DFA to fill in.
+ * initial : Pointer to the DFA to minimize.
+ */
+static void dns_pattern_minimize(struct dns_pattern_dfa *dfa, const struct dns_pattern_dfa *initial)
+{
+    uint32_t states = initial->state_count;
+    uint32_t *blocks = malloc(states * sizeof(uint32_t));
+    uint32_t *next_blocks = malloc(states * sizeof(uint32_t));
+    uint32_t *signature = malloc((initial->class_count + 1) * sizeof(uint32_t));
+    size_t table_capacity = 16;
+    while (table_capacity < (size_t)states * 2)
+    {
+        table_capacity *= 2;
+    }
+    uint32_t *table = malloc(table_capacity * sizeof(uint32_t));
+    if (blocks == NULL || next_blocks == NULL || signature == NULL || table == NULL)
+    {
+        err(1, "malloc");
+    }
+
+    // Start with the accepting and the other states.
+    bool blocks_used[2] = {false, false};
+    for (uint32_t state = 0; state < states; state++)
+    {
+        blocks[state] = initial->accept[state];
+        blocks_used[blocks[state]] = true;
+    }
+    uint32_t block_count = blocks_used[0] + blocks_used[1];
+
+    // Split blocks until states in the same block move to the same blocks.
+    for (;;)
+    {
+        uint32_t next_count = 0;
+        memset(table, 0xFF, table_capacity * sizeof(uint32_t));
+        for (uint32_t state = 0; state < states; state++)
+        {
+            const uint32_t *row = initial->transitions + (size_t)state * initial->class_count;
+            signature[0] = blocks[state];
+            for (uint32_t symbol = 0; symbol < initial->class_count; symbol++)
+            {
+                signature[symbol + 1] = blocks[row[symbol]];
+            }
+            size_t slot = dns_pattern_hash(signature, initial->class_count + 1) & (table_capacity - 1);
+            while (table[slot] != DNS_PATTERN_EMPTY && !dns_pattern_equivalent(initial, blocks, table[slot], state))
+            {
+                slot = (slot + 1) & (table_capacity - 1);
+            }
+            if (table[slot] == DNS_PATTERN_EMPTY)
+            {
+                table[slot] = state;
+                next_blocks[state] = next_count++;
+            }
+            else
+            {
+                next_blocks[state] = next_blocks[table[slot]];
+            }
+        }
+        uint32_t *swap = blocks;
+        blocks = next_blocks;
+        next_blocks = swap;
+        if (next_count == block_count)
+        {
+            break;
+        }
+        block_count = next_count;
+    }
+
+    // Number the blocks so that the dead and start states come first. If
+    // nothing can ever match, the start state is a separate dead state.
+    uint32_t *numbers = next_blocks;
+    memset(numbers, 0xFF, states * sizeof(uint32_t));
+    uint32_t *representatives = malloc((block_count + 1) * sizeof(uint32_t));
+    if (representatives == NULL)
+    {
+        err(1, "malloc");
+    }
+    uint32_t count = 0;
+    numbers[blocks[0]] = count;
+    representatives[count++] = 0;
+    bool start_is_dead = states < 2 || blocks[1] == blocks[0];
+    if (!start_is_dead)
+    {
+        numbers[blocks[1]] = count;
+    }
+    representatives[count++] = start_is_dead ? 0 : 1;
+    for (uint32_t state = 2; state < states; state++)
+    {
+        if (numbers[blocks[state]] == DNS_PATTERN_EMPTY)
+        {
+            numbers[blocks[state]] = count;
+            representatives[count++] = state;
+        }
+    }
+
+    memcpy(dfa->class_map, initial->class_map, sizeof(dfa->class_map));
+    dfa->class_count = initial->class_count;
+    dfa->separator_class = initial->separator_class;
+    dns_pattern_allocate(dfa, count);
+    for (uint32_t state = 0; state < count; state++)
+    {
+        const uint32_t *row = initial->transitions + (size_t)representatives[state] * initial->class_count;
+        for (uint32_t symbol = 0; symbol < dfa->class_count; symbol++)
+        {
+            dfa->transitions[(size_t)state * dfa->class_count + symbol] = numbers[blocks[row[symbol]]];
+        }
+        dfa->accept[state] = initial->accept[representatives[state]];
+    }
+
+    free(representatives);
+    free(blocks);
+    free(next_blocks);
+    free(signature);
+    free(table);
+}
+
+void dns_pattern_compile(struct dns_pattern_dfa *dfa, char **patterns, size_t count, struct dns_pattern_stats *stats)
+{
+    struct timespec start_time, end_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    memset(stats, 0, sizeof(*stats));
+    stats->patterns = count;
+
+    // Compile and minimize every batch, an empty pattern list still gets one.
+    size_t batch_count = count ? (count + DNS_PATTERN_BATCH_SIZE - 1) / DNS_PATTERN_BATCH_SIZE : 1;
+    struct dns_pattern_dfa *batches = calloc(batch_count, sizeof(struct dns_pattern_dfa));
+    if (batches == NULL)
+    {
+        err(1, "calloc");
+    }
+    for (size_t batch = 0; batch < batch_count; batch++)
+    {
+        struct dns_pattern_dfa initial;
+        size_t first = batch * DNS_PATTERN_BATCH_SIZE;
+        size_t batch_size = count - first < DNS_PATTERN_BATCH_SIZE ? count - first : DNS_PATTERN_BATCH_SIZE;
+        dns_pattern_build_batch(&initial, patterns + first, batch_size, &stats->positions);
+        stats->states += initial.state_count;
+        dns_pattern_minimize(&batches[batch], &initial);
+        dns_pattern_free(&initial);
+    }
+
+    // Join neighbouring batches until a single DFA is left.
+    while (batch_count > 1)
+    {
+        size_t joined_count = 0;
+        for (size_t batch = 0; batch < batch_count; batch += 2)
+        {
+            if (batch + 1 == batch_count)
+            {
+                batches[joined_count++] = batches[batch];
+                continue;
+            }
+            struct dns_pattern_dfa initial;
+            dns_pattern_join(&initial, &batches[batch], &batches[batch + 1]);
+            stats->states += initial.state_count;
+            dns_pattern_free(&batches[batch]);
+            dns_pattern_free(&batches[batch + 1]);
+            dns_pattern_minimize(&batches[joined_count++], &initial);
+            dns_pattern_free(&initial);
+        }
+        batch_count = joined_count;
+    }
+    *dfa = batches[0];
+    free(batches);
+    stats->minimized_states = dfa->state_count;
+
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    stats->seconds = (end_time.tv_sec - start_time.tv_sec) + (end_time.tv_nsec - start_time.tv_nsec) / 1e9;
+}
+
+void dns_pattern_load(struct dns_pattern_dfa *dfa, const char *path, struct dns_pattern_stats *stats)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        err(1, "%s", path);
+    }
+    memset(dfa, 0, sizeof(*dfa));
+    memset(stats, 0, sizeof(*stats));
+
+    // A compiled DFA starts with the magic and the byte order marker.
+    char magic[sizeof(DNS_PATTERN_MAGIC)];
+    uint32_t header[4];
+    if (fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, DNS_PATTERN_MAGIC, sizeof(magic)) == 0)
+    {
+        if (fread(header, sizeof(header), 1, file) != 1 || header[0] != DNS_PATTERN_BYTE_ORDER)
+        {
+            errx(1, "%s: not a compiled pattern file for this machine", path);
+        }
+        dfa->state_count = header[1];
+        dfa->class_count = header[2];
+        dfa->separator_class = header[3];
+        if (dfa->state_count < 2 || dfa->state_count > DNS_PATTERN_MAX_STATES || dfa->class_count < 2 ||
+            dfa->class_count > 256 || dfa->separator_class != dfa->class_count - 1)
+        {
+            errx(1, "%s: corrupt compiled pattern file", path);
+        }
+        size_t transition_count = (size_t)dfa->state_count * dfa->class_count;
+        dfa->transitions = malloc(transition_count * sizeof(uint32_t));
+        dfa->accept = malloc(dfa->state_count * sizeof(bool));
+        if (dfa->transitions == NULL || dfa->accept == NULL)
+        {
+            err(1, "malloc");
+        }
+        if (fread(dfa->class_map, sizeof(dfa->class_map), 1, file) != 1 ||
+            fread(dfa->transitions, sizeof(uint32_t), transition_count, file) != transition_count ||
+            fread(dfa->accept, sizeof(bool), dfa->state_count, file) != dfa->state_count)
+        {
+            errx(1, "%s: truncated compiled pattern file", path);
+        }
+        for (size_t i = 0; i < transition_count; i++)
+        {
+            if (dfa->transitions[i] >= dfa->state_count)
+            {
+                errx(1, "%s: corrupt compiled pattern file", path);
+            }
+        }
+        for (int value = 0; value < 256; value++)
+        {
+            if (dfa->class_map[value] >= dfa->separator_class)
+            {
+                errx(1, "%s: corrupt compiled pattern file", path);
+            }
+        }
+
+        // The accepting flags were read as raw bytes, and anything but 0 or 1
+        // is not a valid bool.
+        const uint8_t *accept_bytes = (const uint8_t *)dfa->accept;
+        for (uint32_t state = 0; state < dfa->state_count; state++)
+        {
+            if (accept_bytes[state] > 1)
+            {
+                errx(1, "%s: corrupt compiled pattern file", path);
+            }
+        }
+        fclose(file);
+        return;
+    }
+
+    // Otherwise read one pattern per line, ignoring comments and whitespace.
+    rewind(file);
+    char **patterns = NULL;
+    size_t pattern_count = 0;
+    size_t pattern_capacity = 0;
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &line_capacity, file)) >= 0)
+    {
+        char *comment = strchr(line, '#');
+        if (comment)
+        {
+            *comment = '\0';
+        }
+        char *start = line + strspn(line, " \t\r\n");
+        size_t size = strcspn(start, " \t\r\n");
+        if (size == 0)
+        {
+            continue;
+        }
+        patterns = dns_pattern_grow(patterns, &pattern_capacity, pattern_count + 1, sizeof(char *));
+        patterns[pattern_count] = strndup(start, size);
+        if (patterns[pattern_count] == NULL)
+        {
+            err(1, "strndup");
+        }
+        pattern_count++;
+    }
+    free(line);
+    fclose(file);
+
+    dns_pattern_compile(dfa, patterns, pattern_count, stats);
+    for (size_t i = 0; i < pattern_count; i++)
+    {
+        free(patterns[i]);
+    }
+    free(patterns);
+}
+
+void dns_pattern_save(const struct dns_pattern_dfa *dfa, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        err(1, "%s", path);
+    }
+    uint32_t header[4] = {DNS_PATTERN_BYTE_ORDER, dfa->state_count, dfa->class_count, dfa->separator_class};
+    size_t transition_count = (size_t)dfa->state_count * dfa->class_count;
+    if (fwrite(DNS_PATTERN_MAGIC, sizeof(DNS_PATTERN_MAGIC), 1, file) != 1 ||
+        fwrite(header, sizeof(header), 1, file) != 1 ||
+        fwrite(dfa->class_map, sizeof(dfa->class_map), 1, file) != 1 ||
+        fwrite(dfa->transitions, sizeof(uint32_t), transition_count, file) != transition_count ||
+        fwrite(dfa->accept, sizeof(bool), dfa->state_count, file) != dfa->state_count ||
+        fclose(file))
+    {
+        err(1, "%s", path);
+    }
+}
+
+void dns_pattern_free(struct dns_pattern_dfa *dfa)
+{
+    free(dfa->transitions);
+    free(dfa->accept);
+    memset(dfa, 0, sizeof(*dfa));
+}
+
+bool dns_pattern_match(const struct dns_pattern_dfa *dfa, const uint8_t *name)
+{
+    const uint32_t *transitions = dfa->transitions;
+    uint32_t class_count = dfa->class_count;
+    uint32_t state = DNS_PATTERN_START_STATE;
+    int position = 0;
+
+    while (name[position] > 0)
+    {
+        uint8_t label_size = name[position];
+        if (label_size > DNS_LABEL_MAX_SIZE || position + label_size + 1 >= DNS_NAME_MAX_SIZE)
+        {
+            return false;
+        }
+        if (position > 0)
+        {
+            state = transitions[(size_t)state * class_count + dfa->separator_class];
+        }
+        for (uint8_t i = 1; i <= label_size; i++)
+        {
+            state = transitions[(size_t)state * class_count + dfa->class_map[name[position + i]]];
+        }
+        if (state == DNS_PATTERN_DEAD_STATE)
+        {
+            return false;
+        }
+        position += label_size + 1;
+    }
+    return dfa->accept[state];
+}
+
+void dns_pattern_print_stats(const struct dns_pattern_stats *stats, FILE *stream)
+{
+    fprintf(stream, "patterns: patterns=%zu positions=%zu states=%zu minimized_states=%zu seconds=%.3f\n",
+            stats->patterns, stats->positions, stats->states, stats->minimized_states, stats->seconds);
+}
@@ -0,0 +1,110 @@
+/**
+ * Contains wildcard name patterns, such as "ads*.example.com" or
+ * "*.track.*.net", compiled at load time into a single minimized DFA so that
+ * a question name is matched against every pattern in one linear scan.
+ *
+ * The DFA runs directly over the wire-format labels of the question name:
+ * each label byte is mapped to a symbol class (upper and lower case letters
+ * share a class, so matching ignores case) and a separator symbol is fed
+ * between labels. In patterns, '.' separates labels, '?' matches a single
+ * character within a label, '*' matches any run of characters within a label
+ * and '**' matches any run of characters across labels.
+ */
+#ifndef DNS_PATTERN_H
+#define DNS_PATTERN_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+
+// The limit on the number of states of any DFA built while compiling.
+#define DNS_PATTERN_MAX_STATES (1 << 20)
+
+// The number of patterns compiled together before batches are joined.
+#define DNS_PATTERN_BATCH_SIZE 64
+
+// Marks the start of a compiled DFA file.
+#define DNS_PATTERN_MAGIC "DNSDFA1"
+
+// The dead state, from which no pattern can match, and the start state.
+#define DNS_PATTERN_DEAD_STATE 0
+#define DNS_PATTERN_START_STATE 1
+
+/**
+ * A compiled set of patterns.
+ */
+struct dns_pattern_dfa
+{
+    uint32_t state_count;
+    uint32_t class_count;
+    uint32_t separator_class;
+    uint8_t class_map[256]; // The symbol class of each label byte.
+    uint32_t *transitions;  // state_count rows of class_count next states.
+    bool *accept;           // Whether each state matches.
+};
+
+/**
+ * Counters describing a compilation, reported at startup.
+ */
+struct dns_pattern_stats
+{
+    size_t patterns;
+    size_t positions;
+    size_t states;           // The states of every DFA built, before minimizing.
+    size_t minimized_states; // The states of the final DFA.
+    double seconds;
+};
+
+/**
+ * Compile patterns into a minimized DFA.
+ *
+ * dfa      : Pointer to the DFA to fill in, freed with dns_pattern_free().
+ * patterns : The textual patterns.
+ * count    : The number of patterns.
+ * stats    : Filled with the counters of the compilation.
+ */
+void dns_pattern_compile(struct dns_pattern_dfa *dfa, char **patterns, size_t count, struct dns_pattern_stats *stats);
+
+/**
+ * Load a pattern file, either a text file with one pattern per line (and
+ * '#' comments), which is compiled, or a DFA written by dns_pattern_save().
+ *
+ * dfa   : Pointer to the DFA to fill in, freed with dns_pattern_free().
+ * path  : The path of the pattern file.
+ * stats : Filled with the counters of the compilation, zero if precompiled.
+ */
+void dns_pattern_load(struct dns_pattern_dfa *dfa, const char *path, struct dns_pattern_stats *stats);
+
+/**
+ * Write a compiled DFA to a file so it can be loaded without compiling.
+ *
+ * dfa  : Pointer to the DFA to write.
+ * path : The path of the file to write.
+ */
+void dns_pattern_save(const struct dns_pattern_dfa *dfa, const char *path);
+
+/**
+ * Release the memory held by the DFA.
+ *
+ * dfa : Pointer to the DFA to free.
+ */
+void dns_pattern_free(struct dns_pattern_dfa *dfa);
+
+/**
+ * Match a wire-format question name against all patterns.
+ *
+ * dfa     : Pointer to the compiled patterns.
+ * name    : Pointer to the wire-format question name within the message.
+ * returns : True if any pattern matches the name.
+ */
+bool dns_pattern_match(const struct dns_pattern_dfa *dfa, const uint8_t *name);
+
+/**
+ * Print the counters of a compilation.
+ *
+ * stats  : Pointer to the counters to print.
+ * stream : The stream to print to.
+ */
+void dns_pattern_print_stats(const struct dns_pattern_stats *stats, FILE *stream);
+
+#endif // DNS_PATTERN_H
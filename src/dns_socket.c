@@ -0,0 +1,300 @@
+/**
+ * DNS Socket
+ * Contains implementation of receiving and sending datagrams with their
+ * packet information. Ancillary data handling referenced from cmsg(3), ip(7)
+ * and ipv6(7).
+*/
+
+#define _GNU_SOURCE
+#include <err.h>
+#include <string.h>
+
+#include "dns_socket.h"
+
+void dns_socket_enable_pktinfo(int socket)
+{
+    int enable = 1;
+    struct sockaddr_storage address;
+    socklen_t address_size = sizeof(address);
+    if (getsockname(socket, (struct sockaddr *)&address, &address_size))
+    {
+        err(1, "getsockname");
+    }
+    if (setsockopt(socket, IPPROTO_IP, IP_PKTINFO, &enable, sizeof(enable)))
+    {
+        err(1, "setsockopt IP_PKTINFO");
+    }
+    if (address.ss_family == AF_INET6 && setsockopt(socket, IPPROTO_IPV6, IPV6_RECVPKTINFO, &enable, sizeof(enable)))
+    {
+        err(1, "setsockopt IPV6_RECVPKTINFO");
+    }
+}
+
+void dns_socket_enable_drops(int socket)
+{
+    int enable = 1;
+    if (setsockopt(socket, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable)))
+    {
+        err(1, "setsockopt SO_RXQ_OVFL");
+    }
+}
+
+/**
+ * Set a buffer size, forcing it past the system limit when permitted. The
+ * kernel doubles the requested size to leave room for its bookkeeping, and
+ * the doubled size is what datagrams are charged against.
+ *
+ * socket  : The listening socket.
+ * option  : SO_RCVBUF or SO_SNDBUF.
+ * forced  : SO_RCVBUFFORCE or SO_SNDBUFFORCE.
+ * name    : The name of the buffer, for warnings.
+ * size    : The size the kernel should report.
+ */
+static void dns_socket_size_buffer(int socket, int option, int forced, const char *name, int size)
+{
+    int requested = size / 2;
+    if (setsockopt(socket, SOL_SOCKET, forced, &requested, sizeof(requested)) &&
+        setsockopt(socket, SOL_SOCKET, option, &requested, sizeof(requested)))
+    {
+        err(1, "setsockopt %s", name);
+    }
+
+    int actual;
+    socklen_t actual_size = sizeof(actual);
+    if (getsockopt(socket, SOL_SOCKET, option, &actual, &actual_size))
+    {
+        err(1, "getsockopt %s", name);
+    }
+    if (actual < size)
+    {
+        warnx("%s buffer capped at %d bytes, %d datagrams (raise net.core.%s_max)", name, actual,
+              actual / DNS_SOCKET_DATAGRAM_TRUESIZE, option == SO_RCVBUF ? "rmem" : "wmem");
+    }
+}
+
+void dns_socket_size_buffers(int socket, int burst)
+{
+    dns_socket_size_buffer(socket, SO_RCVBUF, SO_RCVBUFFORCE, "receive", burst * DNS_SOCKET_DATAGRAM_TRUESIZE);
+    dns_socket_size_buffer(socket, SO_SNDBUF, SO_SNDBUFFORCE, "send", burst * DNS_SOCKET_DATAGRAM_TRUESIZE);
+}
+
+void dns_socket_read_buffers(int socket, struct dns_socket_stats *stats)
+{
+    socklen_t size = sizeof(int);
+    if (getsockopt(socket, SOL_SOCKET, SO_RCVBUF, &stats->receive_buffer, &size))
+    {
+        stats->receive_buffer = -1;
+    }
+    size = sizeof(int);
+    if (getsockopt(socket, SOL_SOCKET, SO_SNDBUF, &stats->send_buffer, &size))
+    {
+        stats->send_buffer = -1;
+    }
+}
+
+void dns_socket_print_stats(const struct dns_socket_stats *stats, FILE *stream)
+{
+    fprintf(stream, "socket: drops=%u receive_buffer=%d (%d datagrams) send_buffer=%d\n", stats->drops,
+            stats->receive_buffer, stats->receive_buffer / DNS_SOCKET_DATAGRAM_TRUESIZE, stats->send_buffer);
+}
+
+void dns_socket_map_address(in_addr_t address, struct in6_addr *mapped)
+{
+    memset(mapped, 0, sizeof(*mapped));
+    mapped->s6_addr[10] = 0xFF;
+    mapped->s6_addr[11] = 0xFF;
+    memcpy(&mapped->s6_addr[12], &address, sizeof(address));
+}
+
+/**
+ * Read the local address and interface from the packet information of a
+ * received message, and the drop counter of the socket.
+ *
+ * message  : The received message header.
+ * datagram : Filled with the local address and drop counter, if the kernel
+ *            provided them.
+ */
+static void dns_socket_read_pktinfo(struct msghdr *message, struct dns_datagram *datagram)
+{
+    datagram->peer_size = message->msg_namelen;
+    datagram->has_local = false;
+    datagram->has_drops = false;
+    for (struct cmsghdr *header = CMSG_FIRSTHDR(message); header; header = CMSG_NXTHDR(message, header))
+    {
+        if (header->cmsg_level == IPPROTO_IP && header->cmsg_type == IP_PKTINFO)
+        {
+            struct in_pktinfo info;
+            memcpy(&info, CMSG_DATA(header), sizeof(info));
+            // The specific destination is the local address to reply from,
+            // even if the query was sent to a broadcast address.
+            dns_socket_map_address(info.ipi_spec_dst.s_addr, &datagram->local);
+            datagram->interface = info.ipi_ifindex;
+            datagram->has_local = true;
+        }
+        else if (header->cmsg_level == IPPROTO_IPV6 && header->cmsg_type == IPV6_PKTINFO)
+        {
+            struct in6_pktinfo info;
+            memcpy(&info, CMSG_DATA(header), sizeof(info));
+            datagram->local = info.ipi6_addr;
+            datagram->interface = info.ipi6_ifindex;
+            datagram->has_local = true;
+        }
+        else if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SO_RXQ_OVFL)
+        {
+            memcpy(&datagram->drops, CMSG_DATA(header), sizeof(datagram->drops));
+            datagram->has_drops = true;
+        }
+    }
+}
+
+/**
+ * Address a message to the peer of a datagram, with packet information
+ * selecting the local address to send from when it is known.
+ *
+ * message  : The message header to fill in, its data vector is kept.
+ * control  : Room for the ancillary data, DNS_SOCKET_CONTROL_SIZE bytes.
+ * datagram : The addresses of the query being answered.
+ */
+static void dns_socket_write_pktinfo(struct msghdr *message, uint8_t *control, const struct dns_datagram *datagram)
+{
+    message->msg_name = (void *)&datagram->peer;
+    message->msg_namelen = datagram->peer_size;
+    message->msg_control = NULL;
+    message->msg_controllen = 0;
+    message->msg_flags = 0;
+    if (!datagram->has_local)
+    {
+        return;
+    }
+
+    memset(control, 0, DNS_SOCKET_CONTROL_SIZE);
+    message->msg_control = control;
+    struct cmsghdr *header = (struct cmsghdr *)control;
+    if (IN6_IS_ADDR_V4MAPPED(&datagram->local))
+    {
+        // Only the source address is set, so routing still picks the
+        // outgoing interface.
+        struct in_pktinfo info = {0};
+        memcpy(&info.ipi_spec_dst, &datagram->local.s6_addr[12], sizeof(info.ipi_spec_dst));
+        header->cmsg_level = IPPROTO_IP;
+        header->cmsg_type = IP_PKTINFO;
+        header->cmsg_len = CMSG_LEN(sizeof(info));
+        memcpy(CMSG_DATA(header), &info, sizeof(info));
+        message->msg_controllen = CMSG_SPACE(sizeof(info));
+    }
+    else
+    {
+        // The interface is kept so link-local addresses reach the peer.
+        struct in6_pktinfo info = {.ipi6_addr = datagram->local, .ipi6_ifindex = datagram->interface};
+        header->cmsg_level = IPPROTO_IPV6;
+        header->cmsg_type = IPV6_PKTINFO;
+        header->cmsg_len = CMSG_LEN(sizeof(info));
+        memcpy(CMSG_DATA(header), &info, sizeof(info));
+        message->msg_controllen = CMSG_SPACE(sizeof(info));
+    }
+}
+
+ssize_t dns_socket_receive(int socket, uint8_t *buffer, size_t size, int flags, struct dns_datagram *datagram)
+{
+    uint8_t control[DNS_SOCKET_CONTROL_SIZE] __attribute__((aligned(8)));
+    struct iovec vector = {.iov_base = buffer, .iov_len = size};
+    struct msghdr message = {
+        .msg_name = &datagram->peer,
+        .msg_namelen = sizeof(datagram->peer),
+        .msg_iov = &vector,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+
+    ssize_t received = recvmsg(socket, &message, flags);
+    if (received < 0)
+    {
+        datagram->has_local = false;
+        datagram->has_drops = false;
+        return received;
+    }
+    dns_socket_read_pktinfo(&message, datagram);
+    return received;
+}
+
+ssize_t dns_socket_send(int socket, const uint8_t *buffer, size_t size, const struct dns_datagram *datagram)
+{
+    uint8_t control[DNS_SOCKET_CONTROL_SIZE] __attribute__((aligned(8)));
+    struct iovec vector = {.iov_base = (void *)buffer, .iov_len = size};
+    struct msghdr message = {.msg_iov = &vector, .msg_iovlen = 1};
+    dns_socket_write_pktinfo(&message, control, datagram);
+    return sendmsg(socket, &message, 0);
+}
+
+int dns_socket_receive_batch(int socket, uint8_t buffers[][DNS_UDP_MAX_SIZE], ssize_t *sizes, struct dns_datagram *datagrams, unsigned int count, int flags)
+{
+    uint8_t control[DNS_BATCH_SIZE][DNS_SOCKET_CONTROL_SIZE] __attribute__((aligned(8)));
+    struct iovec vectors[DNS_BATCH_SIZE];
+    struct mmsghdr messages[DNS_BATCH_SIZE];
+    if (count > DNS_BATCH_SIZE)
+    {
+        count = DNS_BATCH_SIZE;
+    }
+
+    memset(messages, 0, count * sizeof(struct mmsghdr));
+    for (unsigned int i = 0; i < count; i++)
+    {
+        vectors[i].iov_base = buffers[i];
+        vectors[i].iov_len = DNS_UDP_MAX_SIZE;
+        messages[i].msg_hdr.msg_name = &datagrams[i].peer;
+        messages[i].msg_hdr.msg_namelen = sizeof(datagrams[i].peer);
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_hdr.msg_control = control[i];
+        messages[i].msg_hdr.msg_controllen = DNS_SOCKET_CONTROL_SIZE;
+    }
+
+    int received = recvmmsg(socket, messages, count, flags, NULL);
+    for (int i = 0; i < received; i++)
+    {
+        sizes[i] = messages[i].msg_len;
+        dns_socket_read_pktinfo(&messages[i].msg_hdr, &datagrams[i]);
+    }
+    return received;
+}
+
+int dns_socket_send_batch(int socket, uint8_t *const *buffers, const ssize_t *sizes, const struct dns_datagram *const *datagrams, unsigned int count)
+{
+    uint8_t control[DNS_BATCH_SIZE][DNS_SOCKET_CONTROL_SIZE] __attribute__((aligned(8)));
+    struct iovec vectors[DNS_BATCH_SIZE];
+    struct mmsghdr messages[DNS_BATCH_SIZE];
+    if (count > DNS_BATCH_SIZE)
+    {
+        count = DNS_BATCH_SIZE;
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        vectors[i].iov_base = buffers[i];
+        vectors[i].iov_len = sizes[i];
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_len = 0;
+        dns_socket_write_pktinfo(&messages[i].msg_hdr, control[i], datagrams[i]);
+    }
+
+    // A single call may stop early, for instance on a full send buffer, and
+    // fails when its first reply cannot be sent at all, such as one to a Unix
+    // socket that has gone away or whose queue is full. That reply is skipped
+    // so the peers after it still get theirs.
+    unsigned int sent = 0;
+    unsigned int next = 0;
+    while (next < count)
+    {
+        int result = sendmmsg(socket, messages + next, count - next, 0);
+        if (result <= 0)
+        {
+            next++;
+            continue;
+        }
+        sent += result;
+        next += result;
+    }
+    return sent ? (int)sent : -1;
+}
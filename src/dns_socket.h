@@ -0,0 +1,157 @@
+/**
+ * Contains methods used to receive queries and send replies on the listening
+ * socket with recvmsg() and sendmsg(). Packet information (IP_PKTINFO and
+ * IPV6_RECVPKTINFO) tells which local address each query arrived on, so that
+ * a socket bound to the wildcard address on a multi-homed host replies from
+ * that same address, and so that the address can pick the answer set. The
+ * SO_RXQ_OVFL counter, also read from the ancillary data, tells how many
+ * queries the kernel dropped because the receive buffer was full.
+ */
+#ifndef DNS_SOCKET_H
+#define DNS_SOCKET_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "dns_defns.h"
+
+// Room for the ancillary data of a single datagram.
+#define DNS_SOCKET_CONTROL_SIZE 128
+
+// An estimate of the kernel memory a single queued datagram takes (its skb
+// truesize, around 800 bytes on loopback), used to turn a burst of queries
+// into a buffer size.
+#define DNS_SOCKET_DATAGRAM_TRUESIZE 1024
+
+/**
+ * The addresses of a received query, used to send its reply.
+ */
+struct dns_datagram
+{
+    struct sockaddr_storage peer;
+    socklen_t peer_size;
+    bool has_local;
+    struct in6_addr local; // The local address, IPv4 addresses are mapped (::ffff:a.b.c.d).
+    int interface;         // The index of the interface the query arrived on.
+    bool has_drops;
+    uint32_t drops; // The datagrams dropped by the socket so far, from SO_RXQ_OVFL.
+};
+
+/**
+ * The drop counter and buffer sizes of a listening socket.
+ */
+struct dns_socket_stats
+{
+    uint32_t drops;     // The latest SO_RXQ_OVFL counter seen.
+    int receive_buffer; // SO_RCVBUF, as reported by the kernel.
+    int send_buffer;    // SO_SNDBUF, as reported by the kernel.
+};
+
+/**
+ * Ask the kernel for the packet information of every received datagram.
+ * Sockets of either family get IP_PKTINFO, and IPv6 sockets additionally get
+ * IPV6_RECVPKTINFO, since a dual-stack socket receives both.
+ *
+ * socket : The listening socket.
+ */
+void dns_socket_enable_pktinfo(int socket);
+
+/**
+ * Ask the kernel to report the number of datagrams dropped by the socket,
+ * with SO_RXQ_OVFL, along with every received datagram.
+ *
+ * socket : The listening socket.
+ */
+void dns_socket_enable_drops(int socket);
+
+/**
+ * Size the receive and send buffers to hold a burst of datagrams, estimating
+ * each at DNS_SOCKET_DATAGRAM_TRUESIZE bytes. Sizes above the system limits
+ * are forced when the process may do so (CAP_NET_ADMIN), and otherwise are
+ * capped with a warning.
+ *
+ * socket : The listening socket.
+ * burst  : The number of datagrams the buffers should hold.
+ */
+void dns_socket_size_buffers(int socket, int burst);
+
+/**
+ * Update the statistics of a socket with its current buffer sizes.
+ *
+ * socket : The listening socket.
+ * stats  : The statistics to update, the drop counter is kept.
+ */
+void dns_socket_read_buffers(int socket, struct dns_socket_stats *stats);
+
+/**
+ * Print the drop counter and buffer sizes of a socket.
+ *
+ * stats  : The statistics to print.
+ * stream : The stream to print to.
+ */
+void dns_socket_print_stats(const struct dns_socket_stats *stats, FILE *stream);
+
+/**
+ * Receive a single datagram along with its addresses.
+ *
+ * socket   : The listening socket.
+ * buffer   : The buffer to receive into.
+ * size     : The size of the buffer.
+ * flags    : Flags passed to recvmsg().
+ * datagram : Filled with the addresses of the datagram.
+ * returns  : The size of the datagram, or -1 on error as for recvmsg().
+ */
+ssize_t dns_socket_receive(int socket, uint8_t *buffer, size_t size, int flags, struct dns_datagram *datagram);
+
+/**
+ * Send a reply to the peer of a datagram, from the local address it arrived
+ * on when that is known.
+ *
+ * socket   : The listening socket.
+ * buffer   : The reply to send.
+ * size     : The size of the reply.
+ * datagram : The addresses of the query being answered.
+ * returns  : The number of bytes sent, or -1 on error as for sendmsg().
+ */
+ssize_t dns_socket_send(int socket, const uint8_t *buffer, size_t size, const struct dns_datagram *datagram);
+
+/**
+ * Receive up to DNS_BATCH_SIZE datagrams with a single recvmmsg() call.
+ *
+ * socket    : The listening socket.
+ * buffers   : The buffers to receive into, one per datagram.
+ * sizes     : Filled with the size of each received datagram.
+ * datagrams : Filled with the addresses of each received datagram.
+ * count     : The number of buffers.
+ * flags     : Flags passed to recvmmsg().
+ * returns   : The number of datagrams received, or -1 on error as for recvmmsg().
+ */
+int dns_socket_receive_batch(int socket, uint8_t buffers[][DNS_UDP_MAX_SIZE], ssize_t *sizes, struct dns_datagram *datagrams, unsigned int count, int flags);
+
+/**
+ * Send up to DNS_BATCH_SIZE replies with sendmmsg(), each from the local
+ * address its query arrived on.
+ *
+ * socket    : The listening socket.
+ * buffers   : The replies to send.
+ * sizes     : The size of each reply.
+ * datagrams : The addresses of the query each reply answers.
+ * count     : The number of replies.
+ * returns   : The number of replies sent, or -1 if none could be sent.
+ *             Replies that cannot be sent are skipped.
+ */
+int dns_socket_send_batch(int socket, uint8_t *const *buffers, const ssize_t *sizes, const struct dns_datagram *const *datagrams, unsigned int count);
+
+/**
+ * Convert an IPv4 address to its mapped IPv6 form, the form local addresses
+ * are compared in.
+ *
+ * address : The IPv4 address, in network byte order.
+ * mapped  : Filled with the mapped address.
+ */
+void dns_socket_map_address(in_addr_t address, struct in6_addr *mapped);
+
+#endif // DNS_SOCKET_H
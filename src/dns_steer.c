@@ -0,0 +1,109 @@
+/**
+ * DNS Steer
+ * Contains implementation of the SO_REUSEPORT steering programs. Classic BPF
+ * loads referenced from filter(2) and socket(7). For reuseport programs the
+ * packet data starts after the UDP header, so the client address is loaded
+ * relative to the network header with SKF_NET_OFF.
+*/
+
+#include <arpa/inet.h>
+#include <err.h>
+#include <string.h>
+#include <netinet/in.h>
+
+#include "dns_steer.h"
+
+// Offsets of the version and the source address in the IPv4 and IPv6 headers.
+#define DNS_STEER_VERSION_OFFSET 0
+#define DNS_STEER_IPV4_SOURCE_OFFSET 12
+#define DNS_STEER_IPV6_SOURCE_OFFSET 8
+
+bool dns_steer_parse_mode(const char *text, enum dns_steer_mode *mode)
+{
+    if (strcmp(text, "kernel") == 0)
+    {
+        *mode = DNS_STEER_KERNEL;
+    }
+    else if (strcmp(text, "client") == 0)
+    {
+        *mode = DNS_STEER_CLIENT;
+    }
+    else if (strcmp(text, "cpu") == 0)
+    {
+        *mode = DNS_STEER_CPU;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+size_t dns_steer_build(enum dns_steer_mode mode, uint32_t workers, struct sock_filter *program)
+{
+    size_t length = 0;
+    if (mode == DNS_STEER_CPU)
+    {
+        program[length++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+        program[length++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, workers);
+        program[length++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_A, 0);
+        return length;
+    }
+
+    // IPv4 clients hash their address, IPv6 clients the four words of theirs
+    // folded together with XOR.
+    program[length++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_NET_OFF + DNS_STEER_VERSION_OFFSET);
+    program[length++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 4);
+    program[length++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 6, 2, 0);
+    program[length++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + DNS_STEER_IPV4_SOURCE_OFFSET);
+    program[length++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JA, 10, 0, 0);
+    program[length++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + DNS_STEER_IPV6_SOURCE_OFFSET);
+    for (int word = 1; word < 4; word++)
+    {
+        program[length++] = (struct sock_filter)BPF_STMT(BPF_MISC | BPF_TAX, 0);
+        program[length++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + DNS_STEER_IPV6_SOURCE_OFFSET + 4 * word);
+        program[length++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0);
+    }
+    program[length++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, DNS_STEER_HASH_MULTIPLIER);
+    program[length++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, DNS_STEER_HASH_SHIFT);
+    program[length++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, workers);
+    program[length++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_A, 0);
+    return length;
+}
+
+void dns_steer_attach(int socket, enum dns_steer_mode mode, uint32_t workers)
+{
+    if (mode == DNS_STEER_KERNEL)
+    {
+        return;
+    }
+    struct sock_filter program[DNS_STEER_MAX_INSTRUCTIONS];
+    struct sock_fprog filter = {.len = dns_steer_build(mode, workers, program), .filter = program};
+    if (setsockopt(socket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &filter, sizeof(filter)))
+    {
+        err(1, "setsockopt SO_ATTACH_REUSEPORT_CBPF");
+    }
+}
+
+uint32_t dns_steer_client_worker(const struct sockaddr *address, uint32_t workers)
+{
+    uint32_t key;
+    if (address->sa_family == AF_INET)
+    {
+        key = ntohl(((const struct sockaddr_in *)address)->sin_addr.s_addr);
+    }
+    else
+    {
+        const struct in6_addr *client = &((const struct sockaddr_in6 *)address)->sin6_addr;
+        uint32_t words[4];
+        memcpy(words, client, sizeof(words));
+        // Mapped clients arrive over IPv4, where the program sees only the
+        // last word.
+        key = ntohl(words[3]);
+        if (!IN6_IS_ADDR_V4MAPPED(client))
+        {
+            key ^= ntohl(words[0]) ^ ntohl(words[1]) ^ ntohl(words[2]);
+        }
+    }
+    return ((uint32_t)(key * DNS_STEER_HASH_MULTIPLIER) >> DNS_STEER_HASH_SHIFT) % workers;
+}
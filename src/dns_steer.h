@@ -0,0 +1,76 @@
+/**
+ * Contains the steering of queries across the sockets of a SO_REUSEPORT
+ * group. By default the kernel hashes the full address and port tuple, so
+ * the queries of a client that picks a new source port for each query land
+ * on different workers and warm every worker's cache with the same names. A
+ * classic BPF program attached with SO_ATTACH_REUSEPORT_CBPF can instead pick
+ * the socket from a hash of the client address alone, or from the CPU that
+ * received the packet, so that each client sticks to one worker.
+ */
+#ifndef DNS_STEER_H
+#define DNS_STEER_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/filter.h>
+#include <sys/socket.h>
+
+// Room for the longest steering program.
+#define DNS_STEER_MAX_INSTRUCTIONS 32
+
+// The multiplier of the client address hash, Knuth's multiplicative constant.
+#define DNS_STEER_HASH_MULTIPLIER 2654435761u
+
+// The hash keeps the bits above this shift, which the multiplier mixes best.
+#define DNS_STEER_HASH_SHIFT 16
+
+/**
+ * How a query picks the socket, and so the worker, that receives it.
+ */
+enum dns_steer_mode
+{
+    DNS_STEER_KERNEL, // The kernel's default hash of the address and port tuple.
+    DNS_STEER_CLIENT, // A hash of the client address.
+    DNS_STEER_CPU,    // The CPU that received the packet.
+};
+
+/**
+ * Parse a steering mode given as "kernel", "client" or "cpu".
+ *
+ * text    : The name of the mode.
+ * mode    : Set to the parsed mode.
+ * returns : True if the name was valid.
+ */
+bool dns_steer_parse_mode(const char *text, enum dns_steer_mode *mode);
+
+/**
+ * Build the steering program of a mode.
+ *
+ * mode    : The steering mode, other than DNS_STEER_KERNEL.
+ * workers : The number of sockets in the group.
+ * program : Filled with up to DNS_STEER_MAX_INSTRUCTIONS instructions.
+ * returns : The number of instructions of the program.
+ */
+size_t dns_steer_build(enum dns_steer_mode mode, uint32_t workers, struct sock_filter *program);
+
+/**
+ * Attach the steering program of a mode to the group of a bound socket. Does
+ * nothing for DNS_STEER_KERNEL.
+ *
+ * socket  : Any bound socket of the group.
+ * mode    : The steering mode.
+ * workers : The number of sockets in the group, in the order they were bound.
+ */
+void dns_steer_attach(int socket, enum dns_steer_mode mode, uint32_t workers);
+
+/**
+ * Compute the worker a client is steered to in DNS_STEER_CLIENT mode, the
+ * same way the steering program does.
+ *
+ * address : The address of the client, IPv4, IPv6 or v4-mapped IPv6.
+ * workers : The number of sockets in the group.
+ * returns : The index of the socket receiving the client's queries.
+ */
+uint32_t dns_steer_client_worker(const struct sockaddr *address, uint32_t workers);
+
+#endif // DNS_STEER_H
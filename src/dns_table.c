@@ -0,0 +1,194 @@
+/**
+ * DNS Table
+ * Contains implementation of the table of names the daemon answers for.
+*/
+
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dns_defns.h"
+#include "dns_table.h"
+
+/**
+ * Lowercase a single ASCII character, leaving other bytes untouched since
+ * label contents are binary as far as RFC 1035 is concerned.
+ */
+static inline uint8_t dns_table_lowercase(uint8_t value)
+{
+    return (value >= 'A' && value <= 'Z') ? value | 0x20 : value;
+}
+
+/**
+ * Allocate the entries of the table for the given capacity and re-insert any
+ * existing entries using their stored hashes.
+ *
+ * table    : Pointer to the table to resize.
+ * capacity : The new capacity, a power of two.
+ */
+static void dns_table_resize(struct dns_table *table, size_t capacity)
+{
+    struct dns_table_entry *old_entries = table->entries;
+    size_t old_capacity = table->capacity;
+
+    table->entries = calloc(capacity, sizeof(*table->entries));
+    if (table->entries == NULL)
+    {
+        err(1, "calloc");
+    }
+    table->capacity = capacity;
+
+    for (size_t i = 0; i < old_capacity; i++)
+    {
+        if (old_entries[i].name_size == 0)
+        {
+            continue;
+        }
+        size_t slot = old_entries[i].hash & (capacity - 1);
+        while (table->entries[slot].name_size)
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        table->entries[slot] = old_entries[i];
+    }
+    free(old_entries);
+}
+
+void dns_table_init(struct dns_table *table, size_t expected)
+{
+    memset(table, 0, sizeof(*table));
+    size_t capacity = 16;
+    while (capacity < expected * 2)
+    {
+        capacity *= 2;
+    }
+    dns_table_resize(table, capacity);
+}
+
+void dns_table_free(struct dns_table *table)
+{
+    free(table->entries);
+    free(table->names);
+    memset(table, 0, sizeof(*table));
+}
+
+uint32_t dns_table_hash(const uint8_t *name, uint8_t name_size)
+{
+    // 32 bit FNV-1a, see http://www.isthe.com/chongo/tech/comp/fnv/index.html
+    uint32_t hash = 2166136261u;
+    for (uint8_t i = 0; i < name_size; i++)
+    {
+        hash ^= name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool dns_table_insert(struct dns_table *table, const uint8_t *name, uint8_t name_size, uint32_t hash, in_addr_t address)
+{
+    if ((table->count + 1) * 2 > table->capacity)
+    {
+        dns_table_resize(table, table->capacity * 2);
+    }
+
+    size_t slot = hash & (table->capacity - 1);
+    while (table->entries[slot].name_size)
+    {
+        struct dns_table_entry *entry = &table->entries[slot];
+        if (entry->hash == hash && entry->name_size == name_size && memcmp(table->names + entry->name_offset, name, name_size) == 0)
+        {
+            return false;
+        }
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+
+    if (table->names_size + name_size > table->names_capacity)
+    {
+        table->names_capacity = table->names_capacity ? table->names_capacity * 2 : 4096;
+        table->names = realloc(table->names, table->names_capacity);
+        if (table->names == NULL)
+        {
+            err(1, "realloc");
+        }
+    }
+    memcpy(table->names + table->names_size, name, name_size);
+
+    table->entries[slot].hash = hash;
+    table->entries[slot].name_offset = table->names_size;
+    table->entries[slot].address = address;
+    table->entries[slot].name_size = name_size;
+    table->names_size += name_size;
+    table->count++;
+    return true;
+}
+
+bool dns_table_lookup(const struct dns_table *table, const uint8_t *name, in_addr_t *address)
+{
+    // Lowercase the question name into a scratch buffer.
+    uint8_t lowercase_name[DNS_NAME_MAX_SIZE];
+    int name_size = 0;
+    while (name[name_size] > 0)
+    {
+        uint8_t label_size = name[name_size];
+        if (label_size > DNS_LABEL_MAX_SIZE || name_size + label_size + 2 > DNS_NAME_MAX_SIZE)
+        {
+            return false;
+        }
+        lowercase_name[name_size] = label_size;
+        for (uint8_t i = 1; i <= label_size; i++)
+        {
+            lowercase_name[name_size + i] = dns_table_lowercase(name[name_size + i]);
+        }
+        name_size += label_size + 1;
+    }
+    lowercase_name[name_size++] = 0;
+
+    uint32_t hash = dns_table_hash(lowercase_name, name_size);
+    size_t slot = hash & (table->capacity - 1);
+    while (table->entries[slot].name_size)
+    {
+        const struct dns_table_entry *entry = &table->entries[slot];
+        if (entry->hash == hash && entry->name_size == name_size && memcmp(table->names + entry->name_offset, lowercase_name, name_size) == 0)
+        {
+            *address = entry->address;
+            return true;
+        }
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+    return false;
+}
+
+uint8_t dns_table_encode_name(const char *text, size_t text_size, uint8_t *name)
+{
+    // Accept a single trailing dot for fully qualified names.
+    if (text_size > 0 && text[text_size - 1] == '.')
+    {
+        text_size--;
+    }
+    if (text_size == 0 || text_size + 2 > DNS_NAME_MAX_SIZE)
+    {
+        return 0;
+    }
+
+    // Each label is prefixed with its length, see RFC 1035 3.1.
+    size_t label_start = 0;
+    for (size_t i = 0; i <= text_size; i++)
+    {
+        if (i == text_size || text[i] == '.')
+        {
+            size_t label_size = i - label_start;
+            if (label_size == 0 || label_size > DNS_LABEL_MAX_SIZE)
+            {
+                return 0;
+            }
+            name[label_start] = label_size;
+            label_start = i + 1;
+        }
+        else
+        {
+            name[i + 1] = dns_table_lowercase(text[i]);
+        }
+    }
+    name[text_size + 1] = 0;
+    return text_size + 2;
+}
@@ -0,0 +1,100 @@
+/**
+ * Contains an in-memory table of the names the daemon answers for, keyed by
+ * the lowercase wire-format name so that it can be searched directly with the
+ * question name of an incoming message.
+ */
+#ifndef DNS_TABLE_H
+#define DNS_TABLE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+
+/**
+ * A single name in the table. The name itself lives in the table's name
+ * buffer. An address of INADDR_ANY means the default address is answered.
+ */
+struct dns_table_entry
+{
+    uint32_t hash;
+    uint32_t name_offset;
+    in_addr_t address;
+    uint8_t name_size; // Zero when the slot is empty.
+};
+
+/**
+ * An open-addressing hash table of names with linear probing. The capacity
+ * is always a power of two and kept at most half full.
+ */
+struct dns_table
+{
+    struct dns_table_entry *entries;
+    size_t capacity;
+    size_t count;
+
+    // Lowercase wire-format names, referenced by offset from the entries.
+    uint8_t *names;
+    size_t names_size;
+    size_t names_capacity;
+};
+
+/**
+ * Initialize an empty table sized for the expected number of names.
+ *
+ * table    : Pointer to the table to initialize.
+ * expected : The number of names the table should hold without growing.
+ */
+void dns_table_init(struct dns_table *table, size_t expected);
+
+/**
+ * Release the memory held by the table.
+ *
+ * table : Pointer to the table to free.
+ */
+void dns_table_free(struct dns_table *table);
+
+/**
+ * Hash a lowercase wire-format name.
+ *
+ * name      : Pointer to the wire-format name.
+ * name_size : The size of the name, including the terminating zero label.
+ * returns   : The 32 bit hash of the name.
+ */
+uint32_t dns_table_hash(const uint8_t *name, uint8_t name_size);
+
+/**
+ * Insert a name unless it is already present, in which case the first
+ * address inserted is kept.
+ *
+ * table     : Pointer to the table to insert into.
+ * name      : Pointer to the lowercase wire-format name.
+ * name_size : The size of the name, including the terminating zero label.
+ * hash      : The hash of the name, as returned by dns_table_hash().
+ * address   : The address to answer with, or INADDR_ANY for the default.
+ * returns   : True if the name was inserted, false if it was a duplicate.
+ */
+bool dns_table_insert(struct dns_table *table, const uint8_t *name, uint8_t name_size, uint32_t hash, in_addr_t address);
+
+/**
+ * Look up the question name of a message in the table. The name is compared
+ * case-insensitively.
+ *
+ * table   : Pointer to the table to search.
+ * name    : Pointer to the wire-format question name within the message.
+ * address : Set to the address of the matching entry.
+ * returns : True if the name is in the table, false otherwise.
+ */
+bool dns_table_lookup(const struct dns_table *table, const uint8_t *name, in_addr_t *address);
+
+/**
+ * Convert a textual domain name into a lowercase wire-format name. A single
+ * trailing dot is accepted.
+ *
+ * text      : Pointer to the textual name, not necessarily terminated.
+ * text_size : The length of the textual name.
+ * name      : Buffer of at least DNS_NAME_MAX_SIZE bytes for the result.
+ * returns   : The size of the wire-format name, zero if the name is invalid.
+ */
+uint8_t dns_table_encode_name(const char *text, size_t text_size, uint8_t *name);
+
+#endif // DNS_TABLE_H
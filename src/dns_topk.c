@@ -0,0 +1,379 @@
+/**
+ * DNS Top-K
+ * Contains implementation of the Space-Saving heavy-hitter tracker.
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+
+#include "dns_topk.h"
+
+// Mask used to select a slot in the hash index.
+#define DNS_TOPK_INDEX_MASK (DNS_TOPK_COUNTERS * 2 - 1)
+
+/**
+ * Hash a key with 32 bit FNV-1a.
+ */
+static uint32_t dns_topk_hash(const uint8_t *key, uint8_t key_size)
+{
+    uint32_t hash = 2166136261u;
+    for (uint8_t i = 0; i < key_size; i++)
+    {
+        hash ^= key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Find the counter tracking the key.
+ *
+ * returns : The counter's index, or -1 if the key is not tracked.
+ */
+static int16_t dns_topk_find(const struct dns_topk *tracker, const uint8_t *key, uint8_t key_size, uint32_t hash)
+{
+    for (uint32_t slot = hash & DNS_TOPK_INDEX_MASK; tracker->index[slot] >= 0; slot = (slot + 1) & DNS_TOPK_INDEX_MASK)
+    {
+        const struct dns_topk_counter *counter = &tracker->counters[tracker->index[slot]];
+        if (counter->hash == hash && counter->key_size == key_size && memcmp(counter->key, key, key_size) == 0)
+        {
+            return tracker->index[slot];
+        }
+    }
+    return -1;
+}
+
+/**
+ * Add a counter to the hash index.
+ */
+static void dns_topk_index_insert(struct dns_topk *tracker, int16_t counter)
+{
+    uint32_t slot = tracker->counters[counter].hash & DNS_TOPK_INDEX_MASK;
+    while (tracker->index[slot] >= 0)
+    {
+        slot = (slot + 1) & DNS_TOPK_INDEX_MASK;
+    }
+    tracker->index[slot] = counter;
+}
+
+/**
+ * Remove a counter from the hash index, shifting later entries of the probe
+ * sequence back so that no tombstones are needed.
+ */
+static void dns_topk_index_remove(struct dns_topk *tracker, int16_t counter)
+{
+    uint32_t hole = tracker->counters[counter].hash & DNS_TOPK_INDEX_MASK;
+    while (tracker->index[hole] != counter)
+    {
+        hole = (hole + 1) & DNS_TOPK_INDEX_MASK;
+    }
+    for (uint32_t slot = (hole + 1) & DNS_TOPK_INDEX_MASK; tracker->index[slot] >= 0; slot = (slot + 1) & DNS_TOPK_INDEX_MASK)
+    {
+        // Move the entry into the hole unless its home slot lies cyclically
+        // between the hole and its current slot.
+        uint32_t home = tracker->counters[tracker->index[slot]].hash & DNS_TOPK_INDEX_MASK;
+        if (((slot - home) & DNS_TOPK_INDEX_MASK) >= ((slot - hole) & DNS_TOPK_INDEX_MASK))
+        {
+            tracker->index[hole] = tracker->index[slot];
+            hole = slot;
+        }
+    }
+    tracker->index[hole] = -1;
+}
+
+/**
+ * Unlink a counter from its bucket, releasing the bucket if it is now empty.
+ */
+static void dns_topk_detach(struct dns_topk *tracker, int16_t counter)
+{
+    struct dns_topk_counter *entry = &tracker->counters[counter];
+    struct dns_topk_bucket *bucket = &tracker->buckets[entry->bucket];
+
+    if (entry->previous >= 0)
+    {
+        tracker->counters[entry->previous].next = entry->next;
+    }
+    else
+    {
+        bucket->head = entry->next;
+    }
+    if (entry->next >= 0)
+    {
+        tracker->counters[entry->next].previous = entry->previous;
+    }
+    if (bucket->head >= 0)
+    {
+        return;
+    }
+
+    if (bucket->previous >= 0)
+    {
+        tracker->buckets[bucket->previous].next = bucket->next;
+    }
+    else
+    {
+        tracker->smallest = bucket->next;
+    }
+    if (bucket->next >= 0)
+    {
+        tracker->buckets[bucket->next].previous = bucket->previous;
+    }
+    bucket->next = tracker->free_bucket;
+    tracker->free_bucket = entry->bucket;
+}
+
+/**
+ * Link a counter into the bucket for the given count, creating the bucket if
+ * needed. The search starts after the hint, a bucket with a smaller count or
+ * -1 to start from the smallest bucket, so a unit increment is constant time.
+ */
+static void dns_topk_place(struct dns_topk *tracker, int16_t counter, uint64_t count, int16_t hint)
+{
+    int16_t before = hint;
+    int16_t after = before >= 0 ? tracker->buckets[before].next : tracker->smallest;
+    while (after >= 0 && tracker->buckets[after].count < count)
+    {
+        before = after;
+        after = tracker->buckets[after].next;
+    }
+
+    int16_t bucket = after;
+    if (after < 0 || tracker->buckets[after].count != count)
+    {
+        bucket = tracker->free_bucket;
+        tracker->free_bucket = tracker->buckets[bucket].next;
+        tracker->buckets[bucket].count = count;
+        tracker->buckets[bucket].head = -1;
+        tracker->buckets[bucket].previous = before;
+        tracker->buckets[bucket].next = after;
+        if (before >= 0)
+        {
+            tracker->buckets[before].next = bucket;
+        }
+        else
+        {
+            tracker->smallest = bucket;
+        }
+        if (after >= 0)
+        {
+            tracker->buckets[after].previous = bucket;
+        }
+    }
+
+    struct dns_topk_counter *entry = &tracker->counters[counter];
+    entry->count = count;
+    entry->bucket = bucket;
+    entry->previous = -1;
+    entry->next = tracker->buckets[bucket].head;
+    if (entry->next >= 0)
+    {
+        tracker->counters[entry->next].previous = counter;
+    }
+    tracker->buckets[bucket].head = counter;
+}
+
+/**
+ * Increase the count of a tracked counter.
+ */
+static void dns_topk_increment(struct dns_topk *tracker, int16_t counter, uint64_t weight)
+{
+    struct dns_topk_counter *entry = &tracker->counters[counter];
+    int16_t bucket = entry->bucket;
+
+    // Search from the current bucket, or from the one before it if the
+    // current bucket is released by the move.
+    bool only_counter = tracker->buckets[bucket].head == counter && entry->next < 0;
+    int16_t hint = only_counter ? tracker->buckets[bucket].previous : bucket;
+    dns_topk_detach(tracker, counter);
+    dns_topk_place(tracker, counter, entry->count + weight, hint);
+}
+
+void dns_topk_init(struct dns_topk *tracker, enum dns_topk_kind kind)
+{
+    memset(tracker, 0, sizeof(*tracker));
+    tracker->kind = kind;
+    tracker->smallest = -1;
+    for (int16_t bucket = 0; bucket < DNS_TOPK_COUNTERS; bucket++)
+    {
+        tracker->buckets[bucket].next = bucket + 1 < DNS_TOPK_COUNTERS ? bucket + 1 : -1;
+    }
+    memset(tracker->index, 0xFF, sizeof(tracker->index));
+}
+
+int16_t dns_topk_add(struct dns_topk *tracker, const uint8_t *key, uint8_t key_size, uint64_t weight)
+{
+    tracker->total += weight;
+    uint32_t hash = dns_topk_hash(key, key_size);
+    int16_t counter = dns_topk_find(tracker, key, key_size, hash);
+    if (counter >= 0)
+    {
+        dns_topk_increment(tracker, counter, weight);
+        return counter;
+    }
+
+    struct dns_topk_counter *entry;
+    if (tracker->used < DNS_TOPK_COUNTERS)
+    {
+        // Take a free counter, starting from a count of zero.
+        counter = tracker->used++;
+        entry = &tracker->counters[counter];
+        entry->hash = hash;
+        entry->key_size = key_size;
+        entry->error = 0;
+        memcpy(entry->key, key, key_size);
+        dns_topk_index_insert(tracker, counter);
+        dns_topk_place(tracker, counter, weight, -1);
+        return counter;
+    }
+
+    // Replace a key with the smallest count, which becomes the error bound.
+    counter = tracker->buckets[tracker->smallest].head;
+    entry = &tracker->counters[counter];
+    dns_topk_index_remove(tracker, counter);
+    entry->hash = hash;
+    entry->key_size = key_size;
+    entry->error = entry->count;
+    memcpy(entry->key, key, key_size);
+    dns_topk_index_insert(tracker, counter);
+    dns_topk_increment(tracker, counter, weight);
+    return counter;
+}
+
+void dns_topk_add_name(struct dns_topk *tracker, const uint8_t *name, const uint8_t *end)
+{
+    uint8_t key[DNS_NAME_MAX_SIZE];
+    int key_size = 0;
+    while (name + key_size < end && name[key_size] > 0)
+    {
+        uint8_t label_size = name[key_size];
+        if (label_size > DNS_LABEL_MAX_SIZE || key_size + label_size + 2 > DNS_NAME_MAX_SIZE || name + key_size + label_size >= end)
+        {
+            return;
+        }
+        key[key_size] = label_size;
+        for (uint8_t i = 1; i <= label_size; i++)
+        {
+            uint8_t value = name[key_size + i];
+            key[key_size + i] = (value >= 'A' && value <= 'Z') ? value | 0x20 : value;
+        }
+        key_size += label_size + 1;
+    }
+    if (name + key_size >= end)
+    {
+        return;
+    }
+    key[key_size++] = 0;
+    dns_topk_add(tracker, key, key_size, 1);
+}
+
+void dns_topk_add_client(struct dns_topk *tracker, const struct sockaddr *address)
+{
+    uint8_t key[1 + sizeof(struct in6_addr)] = {0};
+    uint8_t prefix_size;
+    key[0] = address->sa_family;
+    if (address->sa_family == AF_INET)
+    {
+        prefix_size = DNS_TOPK_IPV4_PREFIX / 8;
+        memcpy(key + 1, &((const struct sockaddr_in *)address)->sin_addr, prefix_size);
+    }
+    else if (address->sa_family == AF_INET6 && IN6_IS_ADDR_V4MAPPED(&((const struct sockaddr_in6 *)address)->sin6_addr))
+    {
+        // IPv4 clients of a dual-stack socket share the prefixes of IPv4 ones.
+        key[0] = AF_INET;
+        prefix_size = DNS_TOPK_IPV4_PREFIX / 8;
+        memcpy(key + 1, &((const struct sockaddr_in6 *)address)->sin6_addr.s6_addr[12], prefix_size);
+    }
+    else if (address->sa_family == AF_INET6)
+    {
+        prefix_size = DNS_TOPK_IPV6_PREFIX / 8;
+        memcpy(key + 1, &((const struct sockaddr_in6 *)address)->sin6_addr, prefix_size);
+    }
+    else
+    {
+        return;
+    }
+    dns_topk_add(tracker, key, 1 + prefix_size, 1);
+}
+
+void dns_topk_merge(struct dns_topk *destination, const struct dns_topk *source)
+{
+    // The stream total includes keys no longer tracked, so sum it directly.
+    uint64_t total = destination->total + source->total;
+    for (int16_t counter = 0; counter < source->used; counter++)
+    {
+        // The source count may itself overestimate the key, so its error
+        // carries over to the merged counter.
+        const struct dns_topk_counter *entry = &source->counters[counter];
+        int16_t merged = dns_topk_add(destination, entry->key, entry->key_size, entry->count);
+        destination->counters[merged].error += entry->error;
+    }
+    destination->total = total;
+}
+
+/**
+ * Order counters by descending count, used with qsort().
+ */
+static int dns_topk_compare(const void *left, const void *right)
+{
+    const struct dns_topk_counter *left_counter = *(const struct dns_topk_counter *const *)left;
+    const struct dns_topk_counter *right_counter = *(const struct dns_topk_counter *const *)right;
+    if (left_counter->count == right_counter->count)
+    {
+        return 0;
+    }
+    return left_counter->count < right_counter->count ? 1 : -1;
+}
+
+/**
+ * Format a tracked key as text.
+ *
+ * tracker : Pointer to the tracker the key belongs to.
+ * counter : Pointer to the counter holding the key.
+ * text    : Buffer of at least DNS_NAME_MAX_SIZE bytes for the text.
+ */
+static void dns_topk_format_key(const struct dns_topk *tracker, const struct dns_topk_counter *counter, char *text)
+{
+    if (tracker->kind == DNS_TOPK_PREFIXES)
+    {
+        uint8_t address[sizeof(struct in6_addr)] = {0};
+        memcpy(address, counter->key + 1, counter->key_size - 1);
+        inet_ntop(counter->key[0], address, text, INET6_ADDRSTRLEN);
+        sprintf(text + strlen(text), "/%d", counter->key[0] == AF_INET ? DNS_TOPK_IPV4_PREFIX : DNS_TOPK_IPV6_PREFIX);
+        return;
+    }
+
+    // Convert the wire-format name into dotted form.
+    int length = 0;
+    for (int position = 0; counter->key[position] > 0; position += counter->key[position] + 1)
+    {
+        memcpy(text + length, counter->key + position + 1, counter->key[position]);
+        length += counter->key[position];
+        text[length++] = '.';
+    }
+    if (length == 0)
+    {
+        text[length++] = '.';
+    }
+    text[length] = '\0';
+}
+
+void dns_topk_print(const struct dns_topk *tracker, int count, FILE *stream)
+{
+    const struct dns_topk_counter *sorted[DNS_TOPK_COUNTERS];
+    for (int16_t counter = 0; counter < tracker->used; counter++)
+    {
+        sorted[counter] = &tracker->counters[counter];
+    }
+    qsort(sorted, tracker->used, sizeof(sorted[0]), dns_topk_compare);
+
+    fprintf(stream, "top %s (of %" PRIu64 "):\n", tracker->kind == DNS_TOPK_NAMES ? "names" : "clients", tracker->total);
+    for (int i = 0; i < count && i < tracker->used; i++)
+    {
+        char text[DNS_NAME_MAX_SIZE];
+        dns_topk_format_key(tracker, sorted[i], text);
+        fprintf(stream, "  %" PRIu64 " (+/-%" PRIu64 ") %s\n", sorted[i]->count, sorted[i]->error, text);
+    }
+}
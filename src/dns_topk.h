@@ -0,0 +1,131 @@
+/**
+ * Contains a streaming top-K tracker of the heaviest hitters, such as the
+ * most queried names or the busiest client prefixes, in bounded memory.
+ *
+ * The tracker implements the Space-Saving algorithm over the stream-summary
+ * structure from Metwally, Agrawal and El Abbadi, "Efficient Computation of
+ * Frequent and Top-k Elements in Data Streams" (2005). Counters sharing a
+ * count are kept in the same bucket and buckets are kept sorted, so a unit
+ * update takes constant time and memory is fixed at DNS_TOPK_COUNTERS keys.
+ */
+#ifndef DNS_TOPK_H
+#define DNS_TOPK_H
+#include <stdio.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+
+#include "dns_defns.h"
+
+// The number of keys tracked, and the number of them reported.
+#define DNS_TOPK_COUNTERS 64
+#define DNS_TOPK_REPORTED 10
+
+// Client prefix lengths used to group client addresses.
+#define DNS_TOPK_IPV4_PREFIX 24
+#define DNS_TOPK_IPV6_PREFIX 56
+
+/**
+ * The kinds of keys tracked, used when printing them.
+ */
+enum dns_topk_kind
+{
+    DNS_TOPK_NAMES,    // Lowercase wire-format question names.
+    DNS_TOPK_PREFIXES, // An address family byte followed by the masked prefix.
+};
+
+/**
+ * A tracked key. The count overestimates the true count by at most the error.
+ */
+struct dns_topk_counter
+{
+    uint64_t count;
+    uint64_t error;
+    uint32_t hash;
+    int16_t bucket;
+    int16_t previous;
+    int16_t next;
+    uint8_t key_size;
+    uint8_t key[DNS_NAME_MAX_SIZE];
+};
+
+/**
+ * All counters with the same count, linked in ascending order of count.
+ */
+struct dns_topk_bucket
+{
+    uint64_t count;
+    int16_t head;
+    int16_t previous;
+    int16_t next;
+};
+
+/**
+ * A fixed-size tracker owned by a single processing loop.
+ */
+struct dns_topk
+{
+    enum dns_topk_kind kind;
+    uint64_t total;
+    int16_t used;
+    int16_t smallest;    // The bucket with the smallest count.
+    int16_t free_bucket; // Unused buckets, linked through next.
+    struct dns_topk_counter counters[DNS_TOPK_COUNTERS];
+    struct dns_topk_bucket buckets[DNS_TOPK_COUNTERS];
+    int16_t index[DNS_TOPK_COUNTERS * 2]; // Hash index of the counters.
+};
+
+/**
+ * Reset the tracker to an empty state.
+ *
+ * tracker : Pointer to the tracker to initialize.
+ * kind    : The kind of keys tracked.
+ */
+void dns_topk_init(struct dns_topk *tracker, enum dns_topk_kind kind);
+
+/**
+ * Count a key a number of times.
+ *
+ * tracker  : Pointer to the tracker to update.
+ * key      : Pointer to the key.
+ * key_size : The size of the key.
+ * weight   : The number of occurrences to count.
+ * returns  : The index of the counter now tracking the key.
+ */
+int16_t dns_topk_add(struct dns_topk *tracker, const uint8_t *key, uint8_t key_size, uint64_t weight);
+
+/**
+ * Count the question name of a message once, ignoring case.
+ *
+ * tracker : Pointer to the tracker to update.
+ * name    : Pointer to the wire-format question name within the message.
+ * end     : Pointer past the end of the message.
+ */
+void dns_topk_add_name(struct dns_topk *tracker, const uint8_t *name, const uint8_t *end);
+
+/**
+ * Count the prefix of a client address once.
+ *
+ * tracker : Pointer to the tracker to update.
+ * address : The client address, an IPv4 or IPv6 socket address.
+ */
+void dns_topk_add_client(struct dns_topk *tracker, const struct sockaddr *address);
+
+/**
+ * Add the counts of one tracker to another, used to merge per-loop trackers
+ * into a single report.
+ *
+ * destination : Pointer to the tracker to add to.
+ * source      : Pointer to the tracker to add from.
+ */
+void dns_topk_merge(struct dns_topk *destination, const struct dns_topk *source);
+
+/**
+ * Print the most frequent keys of the tracker, highest count first.
+ *
+ * tracker : Pointer to the tracker to report on.
+ * count   : The maximum number of keys to print.
+ * stream  : The stream to print to.
+ */
+void dns_topk_print(const struct dns_topk *tracker, int count, FILE *stream);
+
+#endif // DNS_TOPK_H
@@ -2,15 +2,152 @@
  * Run the DNS spoofing daemon on the user-specified address and port.
  */
 
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
 
+#include "dns_arena.h"
+#include "dns_batch.h"
+#include "dns_cache.h"
+#include "dns_config.h"
 #include "dns_defns.h"
+#include "dns_handoff.h"
+#include "dns_loader.h"
 #include "dns_manager.h"
+#include "dns_overload.h"
+#include "dns_pattern.h"
+#include "dns_socket.h"
+#include "dns_steer.h"
+#include "dns_table.h"
+#include "dns_topk.h"
 
-// The buffer associated with the current packet the daemon is handling.
-uint8_t current_packet[DNS_UDP_MAX_SIZE];
+// Answer sets picked by the local address a query arrived on, given with '-m'.
+// Each shares the lists and patterns of the listener the query arrived on.
+#define DNS_MAX_LOCAL_ANSWER_SETS 64
+struct local_answer_set
+{
+    struct in6_addr local; // IPv4 addresses are mapped (::ffff:a.b.c.d).
+    in_addr_t address;
+};
+struct local_answer_set local_answer_sets[DNS_MAX_LOCAL_ANSWER_SETS];
+int local_answer_set_count = 0;
+
+/**
+ * A port or Unix socket path listened on, and the policy answering its
+ * queries. Every worker has a socket in the SO_REUSEPORT group of every port,
+ * and shares the single socket of every path.
+ */
+struct listener
+{
+    int port;
+    int family;
+    const char *path; // The path of a Unix socket, or NULL.
+    struct dns_table table;          // The names loaded from list files.
+    struct dns_pattern_dfa patterns; // Wildcard name patterns compiled into a DFA.
+    struct dns_answer_set answers;   // Rotated over when there are several addresses or any is IPv6.
+    struct dns_answer_policy policy;
+    struct dns_answer_policy local_policies[DNS_MAX_LOCAL_ANSWER_SETS]; // One per local answer set.
+};
+struct listener listeners[DNS_CONFIG_MAX_LISTENERS];
+int listener_count = 0;
+
+// The listeners given on the command line, or loaded with '-c'.
+struct dns_config listener_config;
+
+// The maximum number of workers, user can set the number with '-w'.
+#define DNS_MAX_WORKERS 64
+
+// The maximum number of threads loading lists, user can set it with '-j'.
+#define DNS_MAX_LIST_THREADS 256
+
+/**
+ * A processing loop with its own socket in the SO_REUSEPORT group of each
+ * listener, and everything it touches for each query. Workers share nothing
+ * but the read-only listeners, so they never contend for a cache line outside
+ * of a statistics report.
+ */
+struct dns_worker
+{
+    int index;
+    int sockets[DNS_CONFIG_MAX_LISTENERS]; // One per listener.
+    pthread_t thread;
+
+    // The buffers associated with the batch of packets the worker is
+    // handling, and their headers.
+    uint8_t (*packets)[DNS_UDP_MAX_SIZE];
+    struct dns_batch batch;
+
+    // Responses to recently seen questions.
+    struct dns_cache *cache;
+
+    // The most queried names and the busiest client prefixes.
+    struct dns_topk name_tracker;
+    struct dns_topk client_tracker;
+
+    // Sheds load when queries arrive faster than they can be answered, one
+    // per listener so each watches the backlog of a single socket.
+    struct dns_overload overload[DNS_CONFIG_MAX_LISTENERS];
+
+    // The queries the kernel dropped on each socket, and its buffer sizes.
+    struct dns_socket_stats socket_stats[DNS_CONFIG_MAX_LISTENERS];
+
+    // Picks the rotation slot of each query answered from an answer set.
+    uint32_t rotation;
+
+    // Held while the worker answers a batch, and while the statistics are
+    // read, so the report never sees a tracker halfway through an update.
+    // Only contended while a report is printed.
+    pthread_mutex_t statistics_lock;
+
+    // How the ANY queries of every listener were answered.
+    struct dns_any_stats any_stats;
+} __attribute__((aligned(64)));
+struct dns_worker *workers;
+int worker_count = 1;
+
+// Holds the workers, their buffers and caches, and the tables of every
+// listener. User can set its size with '--max-memory', without which it
+// carves from the heap.
+struct dns_arena arena;
+size_t memory_budget = 0;
+int arena_flags = 0;
+
+// How queries are steered to workers, user can choose with '-s'.
+enum dns_steer_mode steer_mode = DNS_STEER_KERNEL;
+
+// The number of queries each worker handles before it stops, user can set it
+// with '-n', where 0 never stops. The first worker serves the statistics and
+// handoffs, so every worker stops along with it.
+long packet_limit = DNS_NUMBER_OF_PACKETS;
+
+// The burst of queries the socket buffers should hold, user can set it with
+// '-b', where 0 keeps the system defaults.
+int burst_target = 0;
+
+// Written to once the sockets are handed over, or the first worker reaches
+// its limit, to stop every worker.
+int stop_pipe[2] = {-1, -1};
+
+// The degraded mode action of the overload controllers, user can choose it
+// with '-o'.
+enum dns_overload_action overload_action = DNS_OVERLOAD_REFUSE;
+
+// Set by SIGUSR1 to ask the processing loop to print its statistics.
+volatile sig_atomic_t statistics_requested = 0;
+
+// The Unix socket newer instances connect to in order to take over the
+// listening socket, and the connection of a handoff in progress.
+int handoff_listener = -1;
+int handoff_connection = -1;
 
 #ifdef UNIT_TEST
 #define main PRODUCTION_MAIN // Break from macro style a little.
@@ -24,85 +161,793 @@ void display_help_message(void)
 {
     fprintf(stderr, "Run this program with ./dnsspoof. Optionally use -p to specify the port number and -a to specify the IP address,");
     fprintf(stderr, "Otherwise, the program will default to port 12345 and address 6.6.6.6.");
+    fprintf(stderr, "Use -a ADDRESS[@WEIGHT] more than once to rotate answers over several IPv4 and IPv6 addresses, weighted round-robin.");
+    fprintf(stderr, "Use -l to load a hosts-file or plain-domain list (repeatable), only names in the lists are then answered, and -j to set the number of loading threads.");
+    fprintf(stderr, "Use -g to load a file of wildcard name patterns (text or compiled), only matching names are then answered, and -C to write the compiled patterns to a file and exit.");
+    fprintf(stderr, "Use -6 to listen on IPv6 as well as IPv4, replies always leave from the address the query arrived on.");
+    fprintf(stderr, "Use -m LOCAL=ADDRESS (repeatable) to answer queries arriving on the local address LOCAL with ADDRESS instead of the default address.");
+    fprintf(stderr, "Use -y hinfo or -y truncate to answer ANY queries with a single HINFO record or an empty truncated reply (RFC 8482), the default answers them like A queries.");
+    fprintf(stderr, "Use -u PATH to also answer queries from resolvers on this host over a Unix datagram socket at PATH, with the same policy.");
+    fprintf(stderr, "Use -c to load a file of listeners, each with its own port, family, addresses, lists, patterns and ANY mode, all served by the same workers.");
+    fprintf(stderr, "Use -w to set the number of workers, each with its own socket on the port, and -s client or -s cpu to steer each client, or each receiving CPU, to a fixed worker.");
+    fprintf(stderr, "Use -b to size the socket buffers of each worker to hold a burst of that many queries.");
+    fprintf(stderr, "Use -n to set the number of queries each worker answers before exiting, 0 to never exit. The daemon exits once the first worker is done.");
+    fprintf(stderr, "Use -o refuse or -o drop to choose how queries are shed when overloaded, the default is refuse.");
+    fprintf(stderr, "Send SIGUSR1 to print the cache statistics and the most queried names and clients.");
+    fprintf(stderr, "Use --max-memory SIZE[K|M|G] to carve every buffer, cache and table from a memory budget faulted in at startup, failing if they do not fit, with --hugepages to back it with huge pages and --lock-memory to lock it in memory.");
+    fprintf(stderr, "Use -H to specify a handoff socket path, which takes over the sockets of a running instance and lets a later one take over in turn.");
     exit(1);
 }
 
 /**
- * Loop through incoming data sent over the socket, parse the message, modify it
- * in place with a response, and then send the response over the socket.
+ * Signal handler asking the processing loop to print its statistics.
+ *
+ * signal_number : The number of the received signal.
+ */
+void request_statistics(int signal_number)
+{
+    (void)signal_number;
+    statistics_requested = 1;
+}
+
+/**
+ * Print which listener the statistics that follow belong to, when there is
+ * more than one.
+ *
+ * listener : The index of the listener.
+ */
+void print_listener_name(int listener)
+{
+    if (listeners[listener].path)
+    {
+        fprintf(stderr, "path %s ", listeners[listener].path);
+    }
+    else if (listener_count > 1)
+    {
+        fprintf(stderr, "port %d ", listeners[listener].port);
+    }
+}
+
+/**
+ * Print the statistics of every worker, merging the heavy-hitter trackers
+ * into a single report. Each worker is locked in turn, between two batches,
+ * while its counters are read and its trackers merged.
+ */
+void print_statistics(void)
+{
+    static struct dns_topk merged_names;
+    static struct dns_topk merged_clients;
+    uint64_t drops = 0;
+
+    // Every worker reads the same Unix socket, whose drop counter is shared,
+    // so it is reported once with the latest value any worker saw.
+    struct dns_socket_stats path_stats[DNS_CONFIG_MAX_LISTENERS] = {0};
+
+    dns_topk_init(&merged_names, DNS_TOPK_NAMES);
+    dns_topk_init(&merged_clients, DNS_TOPK_PREFIXES);
+    for (int i = 0; i < worker_count; i++)
+    {
+        pthread_mutex_lock(&workers[i].statistics_lock);
+        if (worker_count > 1)
+        {
+            fprintf(stderr, "Worker %d:\n", i);
+        }
+        dns_cache_print_stats(workers[i].cache, stderr);
+        dns_any_print_stats(&workers[i].any_stats, stderr);
+        for (int listener = 0; listener < listener_count; listener++)
+        {
+            struct dns_socket_stats *stats = &workers[i].socket_stats[listener];
+            print_listener_name(listener);
+            dns_overload_print_stats(&workers[i].overload[listener], stderr);
+            if (listeners[listener].path)
+            {
+                if (stats->drops > path_stats[listener].drops)
+                {
+                    path_stats[listener].drops = stats->drops;
+                }
+                continue;
+            }
+            print_listener_name(listener);
+            dns_socket_read_buffers(workers[i].sockets[listener], stats);
+            dns_socket_print_stats(stats, stderr);
+            drops += stats->drops;
+        }
+        dns_topk_merge(&merged_names, &workers[i].name_tracker);
+        dns_topk_merge(&merged_clients, &workers[i].client_tracker);
+        pthread_mutex_unlock(&workers[i].statistics_lock);
+    }
+    for (int listener = 0; listener < listener_count; listener++)
+    {
+        if (listeners[listener].path)
+        {
+            print_listener_name(listener);
+            dns_socket_read_buffers(workers[0].sockets[listener], &path_stats[listener]);
+            dns_socket_print_stats(&path_stats[listener], stderr);
+            drops += path_stats[listener].drops;
+        }
+    }
+    if (worker_count > 1 || listener_count > 1)
+    {
+        fprintf(stderr, "socket drops across workers: %lu\n", (unsigned long)drops);
+    }
+    dns_topk_print(&merged_names, DNS_TOPK_REPORTED, stderr);
+    dns_topk_print(&merged_clients, DNS_TOPK_REPORTED, stderr);
+}
+
+/**
+ * Pick the answer set for a query from the local address it arrived on.
  *
- * socket : The int number associated with the initialized socket.
- * default_address_response : The char array holding the hardcoded response.
+ * listener : The listener the query arrived on.
+ * datagram : The addresses of the query.
+ * variant  : Set to a number identifying the answer set, for the cache.
+ * returns  : The policy of the answer set.
  */
-void process_incoming_data(int socket, char *default_address_response)
+const struct dns_answer_policy *select_answer_policy(const struct listener *listener, const struct dns_datagram *datagram, uint32_t *variant)
 {
-    (void)socket;
-    struct sockaddr_in socket_parameters;
-    unsigned int socket_parameters_len;
+    *variant = 0;
+    if (!datagram->has_local)
+    {
+        return &listener->policy;
+    }
+    for (int set = 0; set < local_answer_set_count; set++)
+    {
+        if (IN6_ARE_ADDR_EQUAL(&local_answer_sets[set].local, &datagram->local))
+        {
+            *variant = set + 1;
+            return &listener->local_policies[set];
+        }
+    }
+    return &listener->policy;
+}
+
+/**
+ * Hand the sockets of every worker over to a newer instance. The first worker
+ * keeps serving until the new instance acknowledges them, then tells every
+ * worker to stop reading and leave the queued queries to it.
+ *
+ * returns : True once the handoff is complete.
+ */
+bool serve_handoff(void)
+{
+    if (handoff_connection < 0)
+    {
+        int sockets[DNS_HANDOFF_MAX_SOCKETS];
+        for (int listener = 0; listener < listener_count; listener++)
+        {
+            for (int i = 0; i < worker_count; i++)
+            {
+                sockets[listener * worker_count + i] = workers[i].sockets[listener];
+            }
+        }
+        handoff_connection = handoff_give_away(handoff_listener, sockets, listener_count * worker_count);
+        return false;
+    }
+    if (handoff_is_complete(handoff_connection))
+    {
+        fprintf(stderr, "Handed the sockets over to the new instance, exiting\n");
+        if (write(stop_pipe[1], "", 1) != 1)
+        {
+            warn("write");
+        }
+        return true;
+    }
+    handoff_connection = -1;
+    return false;
+}
+
+/**
+ * Receive a batch of queries on one of the worker's sockets, answer them and
+ * send the replies.
+ *
+ * worker         : The worker.
+ * listener_index : The listener whose socket is readable.
+ * returns        : The number of queries received.
+ */
+int answer_batch(struct dns_worker *worker, int listener_index)
+{
+    int socket = worker->sockets[listener_index];
+    const struct listener *listener = &listeners[listener_index];
+    struct dns_datagram datagrams[DNS_BATCH_SIZE];
+    ssize_t received_message_sizes[DNS_BATCH_SIZE];
+    uint8_t *packets[DNS_BATCH_SIZE];
+    for (int i = 0; i < DNS_BATCH_SIZE; i++)
+    {
+        packets[i] = worker->packets[i];
+    }
+
+    // Replies queued while the batch is processed, sent together at the end.
+    uint8_t *replies[DNS_BATCH_SIZE];
+    ssize_t reply_sizes[DNS_BATCH_SIZE];
+    const struct dns_datagram *reply_datagrams[DNS_BATCH_SIZE];
+
+    // The socket may be shared with a new instance during a handoff, so
+    // never block waiting for queries it already read.
+    int received_count = dns_socket_receive_batch(socket, worker->packets, received_message_sizes, datagrams, DNS_BATCH_SIZE, MSG_DONTWAIT);
+    if (received_count < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            warn("recvmmsg");
+        }
+        return 0;
+    }
 
-    ssize_t received_message_size;
-    int number_of_packets = 0;
+    // The drop counter only grows, and is only reported once the
+    // socket has dropped anything.
+    if (datagrams[received_count - 1].has_drops)
+    {
+        worker->socket_stats[listener_index].drops = datagrams[received_count - 1].drops;
+    }
+    struct timespec start_time, end_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    dns_batch_load(&worker->batch, packets, received_message_sizes, received_count);
 
-    while (number_of_packets < DNS_NUMBER_OF_PACKETS)
+    int reply_count = 0;
+    int full_path_count = 0;
+    for (int i = 0; i < received_count; i++)
     {
-        socket_parameters_len = sizeof(socket_parameters); // reset the size every time we call recvfrom()
-        received_message_size = recvfrom(socket, current_packet, sizeof(current_packet), 0, (struct sockaddr *)&socket_parameters, (socklen_t *)&socket_parameters_len);
+        uint8_t *packet = worker->packets[i];
+        ssize_t received_message_size = received_message_sizes[i];
+
         // Drop any messages that are smaller than the DNS header size as they are likely invalid.
         if (received_message_size < DNS_HEADER_SIZE)
         {
             fprintf(stderr, "Received message has insufficient length, dropping message\n");
             continue;
         }
-        ssize_t new_message_size = parse_message(current_packet, received_message_size, default_address_response);
+
+        // Track who is asking for what before the message is modified.
+        dns_topk_add_name(&worker->name_tracker, packet + DNS_HEADER_SIZE, packet + received_message_size);
+        dns_topk_add_client(&worker->client_tracker, (struct sockaddr *)&datagrams[i].peer);
+
+        // Under overload, reply cheaply without running the full path.
+        ssize_t new_message_size;
+        if (dns_overload_check(&worker->overload[listener_index], socket))
+        {
+            new_message_size = dns_overload_shed(&worker->overload[listener_index], packet, received_message_size);
+        }
+        else
+        {
+            // Answer repeated questions from the cache, and only parse
+            // the message on a miss. Each listener caches its own answers,
+            // and rotated answers are cached once per slot of the rotation.
+            uint32_t variant;
+            const struct dns_answer_policy *query_policy = select_answer_policy(listener, &datagrams[i], &variant);
+            variant = variant * DNS_CONFIG_MAX_LISTENERS + listener_index;
+            struct dns_answer_policy rotated_policy;
+            if (query_policy->answers)
+            {
+                rotated_policy = *query_policy;
+                rotated_policy.rotation = worker->rotation++ % dns_answer_period(query_policy->answers);
+                variant += (DNS_MAX_LOCAL_ANSWER_SETS + 1) * DNS_CONFIG_MAX_LISTENERS * rotated_policy.rotation;
+                query_policy = &rotated_policy;
+            }
+            new_message_size = dns_cache_lookup(worker->cache, packet, received_message_size, variant);
+            if (new_message_size == 0)
+            {
+                new_message_size = dns_batch_parse(&worker->batch, i, query_policy);
+                dns_cache_insert(worker->cache, packet, new_message_size);
+            }
+            dns_any_count(&worker->any_stats, packet, received_message_size, new_message_size);
+            full_path_count++;
+            if (new_message_size <= DNS_HEADER_SIZE)
+            {
+                fprintf(stderr, "Message is too small , dropping message\n");
+            }
+        }
 
         // If we get some received packet, we can go ahead and respond with it.
         if (new_message_size > DNS_HEADER_SIZE)
         {
-            if (sendto(socket, current_packet, new_message_size, 0, (struct sockaddr *)&socket_parameters, (socklen_t)(socket_parameters_len)) != new_message_size)
+            replies[reply_count] = packet;
+            reply_sizes[reply_count] = new_message_size;
+            reply_datagrams[reply_count] = &datagrams[i];
+            reply_count++;
+        }
+    }
+    if (reply_count > 0 && dns_socket_send_batch(socket, replies, reply_sizes, reply_datagrams, reply_count) != reply_count)
+    {
+        warn("sendmmsg");
+    }
+
+    // The full path is timed per batch, and each query is charged its
+    // share of the time.
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    if (full_path_count > 0)
+    {
+        uint64_t batch_ns = (end_time.tv_sec - start_time.tv_sec) * 1000000000ull + end_time.tv_nsec - start_time.tv_nsec;
+        dns_overload_record_latency(&worker->overload[listener_index], batch_ns / full_path_count);
+    }
+    return received_count;
+}
+
+/**
+ * Loop through incoming data sent over the worker's sockets, parse the
+ * message, modify it in place with a response, and then send the response
+ * over the socket it arrived on. The first worker also serves statistics
+ * requests and handoffs.
+ *
+ * worker : The worker, with its sockets set.
+ */
+void process_incoming_data(struct dns_worker *worker)
+{
+    long number_of_packets = 0;
+
+    pthread_mutex_lock(&worker->statistics_lock);
+    dns_cache_init(worker->cache);
+    dns_topk_init(&worker->name_tracker, DNS_TOPK_NAMES);
+    dns_topk_init(&worker->client_tracker, DNS_TOPK_PREFIXES);
+    for (int listener = 0; listener < listener_count; listener++)
+    {
+        dns_overload_init(&worker->overload[listener], overload_action);
+    }
+    memset(worker->socket_stats, 0, sizeof(worker->socket_stats));
+    worker->rotation = 0;
+    pthread_mutex_unlock(&worker->statistics_lock);
+
+    // A single event loop serves the sockets of every listener, then the
+    // pipe stopping the workers and, on the first worker, the handoff socket.
+    struct pollfd poll_fds[DNS_CONFIG_MAX_LISTENERS + 2];
+    int stop_index = listener_count;
+    int handoff_index = listener_count + 1;
+    for (int listener = 0; listener < listener_count; listener++)
+    {
+        poll_fds[listener] = (struct pollfd){.fd = worker->sockets[listener], .events = POLLIN};
+    }
+    poll_fds[stop_index] = (struct pollfd){.fd = stop_pipe[0], .events = POLLIN};
+
+    while (packet_limit == 0 || number_of_packets < packet_limit)
+    {
+        // Wait for a query, for the other workers to stop, or on the first
+        // worker for a newer instance taking over the sockets.
+        poll_fds[handoff_index] = (struct pollfd){.fd = handoff_connection >= 0 ? handoff_connection : handoff_listener, .events = POLLIN};
+        int poll_result = poll(poll_fds, worker->index == 0 ? handoff_index + 1 : handoff_index, -1);
+        if (worker->index == 0 && statistics_requested)
+        {
+            statistics_requested = 0;
+            print_statistics();
+        }
+        if (poll_result < 0)
+        {
+            if (errno != EINTR)
             {
-                warn("sendto");
+                warn("poll");
             }
+            continue;
         }
-        else
+        if (poll_fds[stop_index].revents)
+        {
+            break;
+        }
+
+        // Keep serving until the new instance acknowledges the sockets, then
+        // stop reading and leave the queued queries to it.
+        if (worker->index == 0 && poll_fds[handoff_index].revents && serve_handoff())
         {
-            fprintf(stderr, "Message is too small , dropping message\n");
+            break;
+        }
+        for (int listener = 0; listener < listener_count; listener++)
+        {
+            if (poll_fds[listener].revents & POLLIN)
+            {
+                pthread_mutex_lock(&worker->statistics_lock);
+                number_of_packets += answer_batch(worker, listener);
+                pthread_mutex_unlock(&worker->statistics_lock);
+            }
         }
-        number_of_packets++;
     }
 }
 
 /**
- * Initializes socket and starts processing incoming packets.
- * 
- * param port : The port number associated with the socket.
- * param default_address_response : The hardcoded address to respond to all
- *                                  requests with.
-*/
-void initialize_data_processing(int port, char *default_address_response)
+ * Run a worker on its own thread.
+ *
+ * argument : The worker.
+ * returns  : NULL.
+ */
+void *run_worker(void *argument)
 {
-    (void)port;
-    int new_socket;
-    struct sockaddr_in socket_parameters;
+    process_incoming_data(argument);
+    return NULL;
+}
 
-    new_socket = socket(PF_INET, SOCK_DGRAM, 0);
+/**
+ * Take over the listening sockets of the instance running on the handoff
+ * path, and start listening for a later instance to hand them over to in
+ * turn.
+ *
+ * param handoff_path : The filesystem path of the handoff socket.
+ * param sockets : Filled with the inherited socket of each listener and
+ *                 worker.
+ * returns : True if the sockets were taken over, false if no instance is
+ *           running and they have to be bound from scratch.
+ */
+bool take_over_sockets(char *handoff_path, int sockets[][DNS_MAX_WORKERS])
+{
+    int inherited[DNS_HANDOFF_MAX_SOCKETS];
+    int handoff_connection;
+    int inherited_count = handoff_take_over(handoff_path, inherited, DNS_HANDOFF_MAX_SOCKETS, &handoff_connection);
+    bool usable = inherited_count == listener_count * worker_count;
+    for (int i = 0; i < inherited_count && usable; i++)
+    {
+        // Only keep the sockets if they serve the ports and paths we were
+        // asked for, in the order of the listeners. The port sits at the same
+        // offset in IPv4 and IPv6 addresses.
+        const struct listener *listener = &listeners[i / worker_count];
+        struct sockaddr_storage socket_parameters;
+        socklen_t socket_parameters_len = sizeof(socket_parameters);
+        usable = getsockname(inherited[i], (struct sockaddr *)&socket_parameters, &socket_parameters_len) == 0 &&
+                 socket_parameters.ss_family == listener->family;
+        if (usable && listener->path)
+        {
+            usable = strcmp(((struct sockaddr_un *)&socket_parameters)->sun_path, listener->path) == 0;
+        }
+        else if (usable)
+        {
+            usable = ntohs(((struct sockaddr_in *)&socket_parameters)->sin_port) == listener->port;
+        }
+        sockets[i / worker_count][i % worker_count] = inherited[i];
+    }
+    if (inherited_count > 0 && usable)
+    {
+        handoff_acknowledge(handoff_connection, true);
+        fprintf(stderr, "Took over %d sockets of %d listeners from the running instance\n", inherited_count, listener_count);
+    }
+    else if (inherited_count > 0)
+    {
+        // The running instance still holds the ports, so binding them again
+        // could fail. Leave it serving, along with its handoff socket.
+        for (int i = 0; i < inherited_count; i++)
+        {
+            close(inherited[i]);
+        }
+        handoff_acknowledge(handoff_connection, false);
+        errx(1, "The running instance does not serve the same listeners with %d workers, leaving it serving", worker_count);
+    }
+    handoff_listener = handoff_listen(handoff_path);
+    return inherited_count > 0 && usable;
+}
+
+/**
+ * Create a socket bound to the wildcard address of the port, joining the
+ * SO_REUSEPORT group of the port when there are several workers.
+ *
+ * param port : The port number associated with the socket.
+ * param family : AF_INET, or AF_INET6 for a dual-stack socket.
+ * returns : The bound socket.
+ */
+int bind_listening_socket(int port, int family)
+{
+    int new_socket = socket(family, SOCK_DGRAM, 0);
 
     if (new_socket < 0)
     {
         err(1, "socket");
     }
 
-    // Set the port number.
-    socket_parameters.sin_port = htons(port);
-    // Set other socket parameters for DNS/Internet.
-    socket_parameters.sin_family = AF_INET;
-    socket_parameters.sin_addr.s_addr = INADDR_ANY;
-    // Bind socket.
-    int bind_result = bind(new_socket, (struct sockaddr *)&socket_parameters, sizeof(socket_parameters));
+    int enable = 1;
+    if ((worker_count > 1 || steer_mode != DNS_STEER_KERNEL) &&
+        setsockopt(new_socket, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)))
+    {
+        err(1, "setsockopt SO_REUSEPORT");
+    }
+
+    // Bind the wildcard address, replies still leave from the address each
+    // query arrived on thanks to the packet information.
+    int bind_result;
+    if (family == AF_INET6)
+    {
+        int v6_only = 0;
+        if (setsockopt(new_socket, IPPROTO_IPV6, IPV6_V6ONLY, &v6_only, sizeof(v6_only)))
+        {
+            err(1, "setsockopt IPV6_V6ONLY");
+        }
+        struct sockaddr_in6 socket_parameters = {.sin6_family = AF_INET6, .sin6_port = htons(port), .sin6_addr = IN6ADDR_ANY_INIT};
+        bind_result = bind(new_socket, (struct sockaddr *)&socket_parameters, sizeof(socket_parameters));
+    }
+    else
+    {
+        struct sockaddr_in socket_parameters = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = INADDR_ANY};
+        bind_result = bind(new_socket, (struct sockaddr *)&socket_parameters, sizeof(socket_parameters));
+    }
     if (bind_result)
     {
         err(1, "bind");
     }
-    process_incoming_data(new_socket, default_address_response);
+    return new_socket;
+}
+
+/**
+ * Create a Unix datagram socket bound to a path, replacing a stale socket
+ * left at the path by an instance that exited without handing it over. A
+ * socket still served by a running instance is never replaced. The socket
+ * does not block, so a reply to a client whose queue is full is dropped
+ * rather than stalling the worker.
+ *
+ * param path : The path of the socket.
+ * returns : The bound socket.
+ */
+int bind_unix_socket(const char *path)
+{
+    int new_socket = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (new_socket < 0)
+    {
+        err(1, "socket");
+    }
+
+    struct sockaddr_un socket_parameters = {.sun_family = AF_UNIX};
+    strncpy(socket_parameters.sun_path, path, sizeof(socket_parameters.sun_path) - 1);
+
+    // Only a socket nobody is bound to refuses connections, see unix(7).
+    struct stat status;
+    if (lstat(path, &status) == 0 && S_ISSOCK(status.st_mode))
+    {
+        int probe = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if (probe < 0)
+        {
+            err(1, "socket");
+        }
+        int connected = connect(probe, (struct sockaddr *)&socket_parameters, sizeof(socket_parameters));
+        int connect_error = errno;
+        close(probe);
+        if (connected == 0 || connect_error != ECONNREFUSED)
+        {
+            errx(1, "%s is served by a running instance, use -H to take it over", path);
+        }
+        if (unlink(path))
+        {
+            err(1, "unlink %s", path);
+        }
+    }
+    if (bind(new_socket, (struct sockaddr *)&socket_parameters, sizeof(socket_parameters)))
+    {
+        err(1, "bind %s", path);
+    }
+    return new_socket;
+}
+
+/**
+ * Initializes the sockets of the workers on every listener and starts
+ * processing incoming packets, with the first worker on the calling thread.
+ * 
+ * param handoff_path : The handoff socket path, or NULL to always bind.
+*/
+void initialize_data_processing(char *handoff_path)
+{
+    int sockets[DNS_CONFIG_MAX_LISTENERS][DNS_MAX_WORKERS];
+
+    // A running instance keeps serving until this one is ready, so the
+    // handoff happens last, right before processing starts.
+    if (handoff_path == NULL || !take_over_sockets(handoff_path, sockets))
+    {
+        // Sockets join the group of their listener in order, which is the
+        // worker index the steering program returns. Unix sockets have no
+        // such group, so every worker reads the same one.
+        for (int listener = 0; listener < listener_count; listener++)
+        {
+            int unix_socket = listeners[listener].path ? bind_unix_socket(listeners[listener].path) : -1;
+            for (int i = 0; i < worker_count; i++)
+            {
+                sockets[listener][i] = unix_socket >= 0 ? unix_socket : bind_listening_socket(listeners[listener].port, listeners[listener].family);
+            }
+        }
+    }
+    for (int listener = 0; listener < listener_count; listener++)
+    {
+        if (listeners[listener].path == NULL)
+        {
+            dns_steer_attach(sockets[listener][0], steer_mode, worker_count);
+        }
+    }
+    if (pipe(stop_pipe))
+    {
+        err(1, "pipe");
+    }
+
+    // Only the first worker, on this thread, serves statistics requests.
+    sigset_t statistics_signal;
+    sigemptyset(&statistics_signal);
+    sigaddset(&statistics_signal, SIGUSR1);
+    signal(SIGUSR1, request_statistics);
+    pthread_sigmask(SIG_BLOCK, &statistics_signal, NULL);
+    for (int i = 0; i < worker_count; i++)
+    {
+        workers[i].index = i;
+        for (int listener = 0; listener < listener_count; listener++)
+        {
+            int socket = sockets[listener][i];
+            workers[i].sockets[listener] = socket;
+
+            // The workers share the Unix socket, which is set up once.
+            if (listeners[listener].path && i > 0)
+            {
+                continue;
+            }
+            if (listeners[listener].path == NULL)
+            {
+                dns_socket_enable_pktinfo(socket);
+            }
+            dns_socket_enable_drops(socket);
+            if (burst_target > 0)
+            {
+                dns_socket_size_buffers(socket, burst_target);
+            }
+        }
+        if (i > 0 && pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]))
+        {
+            errx(1, "pthread_create");
+        }
+    }
+    pthread_sigmask(SIG_UNBLOCK, &statistics_signal, NULL);
+
+    // Without the first worker nothing serves the statistics or a handoff,
+    // so the others stop along with it.
+    process_incoming_data(&workers[0]);
+    if (write(stop_pipe[1], "", 1) != 1)
+    {
+        warn("write");
+    }
+    for (int i = 1; i < worker_count; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+    print_statistics();
+}
+
+/**
+ * Load the lists and patterns of a listener and build its answer policies.
+ * Done before the sockets are bound or taken over, so a running instance
+ * keeps serving while they load.
+ *
+ * param listener : The listener to set up.
+ * param config : The description of the listener.
+ * param list_threads : The number of threads loading lists, 0 for all cores.
+ */
+void setup_listener(struct listener *listener, struct dns_listener_config *config, int list_threads)
+{
+    listener->port = config->port;
+    listener->family = config->family;
+    listener->path = config->path;
+
+    // Convert the address once, rather than for every answer. A single IPv4
+    // address is answered directly, anything more is compiled into a set.
+    dns_answer_init(&listener->answers);
+    for (int i = 0; i < config->address_count; i++)
+    {
+        dns_answer_add(&listener->answers, config->addresses[i]);
+    }
+    listener->policy.address = inet_addr("6.6.6.6");
+    listener->policy.any = config->any;
+    if (listener->answers.a.count > 0)
+    {
+        memcpy(&listener->policy.address, listener->answers.a.addresses[0], sizeof(in_addr_t));
+    }
+    if (listener->answers.a.count > 1 || listener->answers.aaaa.count > 0)
+    {
+        dns_answer_compile(&listener->answers);
+        dns_answer_print(&listener->answers, stderr);
+        listener->policy.answers = &listener->answers;
+    }
+
+    if (config->list_count > 0)
+    {
+        struct dns_load_stats load_stats;
+        dns_table_init(&listener->table, 0);
+        dns_load_lists(&listener->table, config->lists, config->list_count, list_threads, &load_stats);
+        dns_load_print_stats(&load_stats, stderr);
+        listener->policy.table = &listener->table;
+    }
+
+    if (config->patterns)
+    {
+        struct dns_pattern_stats pattern_stats;
+        dns_pattern_load(&listener->patterns, config->patterns, &pattern_stats);
+        dns_pattern_print_stats(&pattern_stats, stderr);
+        listener->policy.patterns = &listener->patterns;
+    }
+
+    // Local answer sets share the lists and patterns of the listener, but
+    // answer with their own single address.
+    for (int set = 0; set < local_answer_set_count; set++)
+    {
+        listener->local_policies[set] = listener->policy;
+        listener->local_policies[set].address = local_answer_sets[set].address;
+        listener->local_policies[set].answers = NULL;
+    }
+}
+
+/**
+ * Parse a local answer set given as LOCAL=ADDRESS, where LOCAL is an IPv4 or
+ * IPv6 local address and ADDRESS the IPv4 address to answer with.
+ *
+ * param argument : The argument of '-m'.
+ * returns : True if the answer set was valid and added.
+ */
+bool parse_local_answer_set(char *argument)
+{
+    char *separator = strchr(argument, '=');
+    if (separator == NULL || local_answer_set_count == DNS_MAX_LOCAL_ANSWER_SETS)
+    {
+        return false;
+    }
+    *separator = '\0';
+
+    struct local_answer_set *set = &local_answer_sets[local_answer_set_count];
+    struct in_addr local;
+    if (inet_pton(AF_INET, argument, &local) == 1)
+    {
+        dns_socket_map_address(local.s_addr, &set->local);
+    }
+    else if (inet_pton(AF_INET6, argument, &set->local) != 1)
+    {
+        return false;
+    }
+    set->address = inet_addr(separator + 1);
+    if (set->address == INADDR_NONE)
+    {
+        return false;
+    }
+    local_answer_set_count++;
+    return true;
+}
+
+/**
+ * Carve the workers, their packet buffers and their caches from the arena.
+ * Done before the lists load, so a budget too small for the workers fails
+ * right away.
+ */
+void allocate_workers(void)
+{
+    workers = dns_arena_alloc(&arena, worker_count * sizeof(*workers), "worker state");
+    for (int i = 0; i < worker_count; i++)
+    {
+        workers[i].packets = dns_arena_alloc(&arena, DNS_BATCH_SIZE * sizeof(*workers[i].packets), "packet buffers");
+        workers[i].cache = dns_arena_alloc(&arena, sizeof(*workers[i].cache), "response caches");
+        pthread_mutex_init(&workers[i].statistics_lock, NULL);
+    }
+}
+
+/**
+ * Move the tables, patterns and answer records of a listener, which are
+ * built on the heap while loading, into the arena.
+ *
+ * param listener : The listener, set up with setup_listener().
+ */
+void move_listener_to_arena(struct listener *listener)
+{
+    if (listener->policy.table)
+    {
+        struct dns_table *table = &listener->table;
+        struct dns_table_entry *entries = table->entries;
+        uint8_t *names = table->names;
+        table->entries = dns_arena_copy(&arena, entries, table->capacity * sizeof(*entries), "list tables");
+        table->names = dns_arena_copy(&arena, names, table->names_size, "list names");
+        table->names_capacity = table->names_size;
+        free(entries);
+        free(names);
+    }
+    if (listener->policy.patterns)
+    {
+        struct dns_pattern_dfa *dfa = &listener->patterns;
+        uint32_t *transitions = dfa->transitions;
+        bool *accept = dfa->accept;
+        dfa->transitions = dns_arena_copy(&arena, transitions, (size_t)dfa->state_count * dfa->class_count * sizeof(*transitions), "pattern DFAs");
+        dfa->accept = dns_arena_copy(&arena, accept, dfa->state_count * sizeof(*accept), "pattern DFAs");
+        free(transitions);
+        free(accept);
+    }
+    if (listener->policy.answers)
+    {
+        struct dns_answer_family *families[] = {&listener->answers.a, &listener->answers.aaaa};
+        for (int i = 0; i < 2; i++)
+        {
+            uint8_t *records = families[i]->records;
+            if (records)
+            {
+                families[i]->records = dns_arena_copy(&arena, records, (size_t)families[i]->slot_count * families[i]->count * families[i]->record_size, "answer records");
+                free(records);
+            }
+        }
+    }
 }
 
 /** 
@@ -116,42 +961,247 @@ int main(int argc, char *argv[])
 {
     // Current argument (for parsing incoming arguments).
     int current;
-    // Default port number, user can overwrite with '-p' command.
-    int portnum = 12345;
-    // Defauylt address response, user can overwrite with '-a' command.
-    char default_address_response[100] = "6.6.6.6";
+    // The listener described on the command line. Default port number and
+    // address, user can overwrite with '-p' and '-a' commands, or give
+    // several addresses to rotate over.
+    struct dns_listener_config *command_line = &listener_config.listeners[0];
+    dns_config_init_listener(command_line);
+    bool listener_options = false;
+    // Configuration file describing every listener, user can set with '-c'.
+    char *config_path = NULL;
+    // Unix socket serving the listener of the command line as well, user can
+    // set with '-u'.
+    struct dns_listener_config unix_listener;
+    dns_config_init_listener(&unix_listener);
+    // Handoff socket path for restarts, user can set with '-H' command.
+    char *handoff_path = NULL;
+    // Number of threads loading lists, user can set with '-j'.
+    int list_threads = 0;
+    unsigned long number; // Counts given on the command line, checked before use.
+    // Where to write the compiled patterns with '-C'.
+    char *compiled_pattern_path = NULL;
+    // The options without a short form, which set the memory budget.
+    static const struct option long_options[] = {
+        {"max-memory", required_argument, NULL, 'M'},
+        {"hugepages", no_argument, NULL, 'P'},
+        {"lock-memory", no_argument, NULL, 'L'},
+        {NULL, 0, NULL, 0},
+    };
 
     // Iterate through incoming arguments. Referenced following resource:
     // https://www.geeksforgeeks.org/getopt-function-in-c-to-parse-command-line-arguments/
-    while ((current = getopt(argc, argv, "p:h:a:")) != -1)
+    while ((current = getopt_long(argc, argv, "p:h:a:H:l:j:o:g:C:6m:w:s:n:b:c:y:u:", long_options, NULL)) != -1)
     {
         switch ((char)current)
         {
+        case 'M':
+            memory_budget = dns_arena_parse_size(optarg);
+            if (memory_budget == 0)
+            {
+                fprintf(stderr, "Memory budget invalid.");
+                display_help_message();
+            }
+            break;
+        case 'P':
+            arena_flags |= DNS_ARENA_HUGEPAGES;
+            break;
+        case 'L':
+            arena_flags |= DNS_ARENA_LOCK;
+            break;
         case 'h':
             display_help_message();
             break;
         case 'p':
-            portnum = strtoul(optarg, &optarg, 0);
-            if (portnum == 0)
+            listener_options = true;
+            if (!dns_config_set(command_line, "port", optarg))
             {
                 fprintf(stderr, "Port number invalid.");
                 display_help_message();
             }
             break;
         case 'a':
-            strncpy(default_address_response, optarg, sizeof(default_address_response));
-            if (inet_addr(default_address_response) < 0)
+            listener_options = true;
+            if (!dns_config_set(command_line, "address", optarg))
             {
                 fprintf(stderr, "IP address invalid.");
                 display_help_message();
             }
             break;
+        case 'c':
+            config_path = optarg;
+            break;
+        case 'u':
+            listener_options = true;
+            if (!dns_config_set(&unix_listener, "path", optarg))
+            {
+                fprintf(stderr, "Unix socket path invalid.");
+                display_help_message();
+            }
+            break;
+        case 'H':
+            handoff_path = optarg;
+            break;
+        case 'l':
+            listener_options = true;
+            if (!dns_config_set(command_line, "list", optarg))
+            {
+                fprintf(stderr, "Too many list files.");
+                display_help_message();
+            }
+            break;
+        case 'j':
+            number = strtoul(optarg, &optarg, 0);
+            if (*optarg != '\0' || number > DNS_MAX_LIST_THREADS)
+            {
+                fprintf(stderr, "Number of loading threads invalid.");
+                display_help_message();
+            }
+            list_threads = number;
+            break;
+        case 'g':
+            listener_options = true;
+            command_line->patterns = optarg;
+            break;
+        case 'y':
+            listener_options = true;
+            if (!dns_config_set(command_line, "any", optarg))
+            {
+                fprintf(stderr, "ANY mode invalid.");
+                display_help_message();
+            }
+            break;
+        case '6':
+            listener_options = true;
+            command_line->family = AF_INET6;
+            break;
+        case 'm':
+            if (!parse_local_answer_set(optarg))
+            {
+                fprintf(stderr, "Local answer set invalid.");
+                display_help_message();
+            }
+            break;
+        case 'C':
+            compiled_pattern_path = optarg;
+            break;
+        case 'w':
+            number = strtoul(optarg, &optarg, 0);
+            if (*optarg != '\0' || number < 1 || number > DNS_MAX_WORKERS)
+            {
+                fprintf(stderr, "Number of workers invalid.");
+                display_help_message();
+            }
+            worker_count = number;
+            break;
+        case 's':
+            if (!dns_steer_parse_mode(optarg, &steer_mode))
+            {
+                fprintf(stderr, "Steering mode invalid.");
+                display_help_message();
+            }
+            break;
+        case 'n':
+            packet_limit = strtol(optarg, &optarg, 0);
+            if (packet_limit < 0 || *optarg != '\0')
+            {
+                fprintf(stderr, "Number of packets invalid.");
+                display_help_message();
+            }
+            break;
+        case 'b':
+            burst_target = strtoul(optarg, &optarg, 0);
+            if (burst_target < 1 || burst_target > INT_MAX / DNS_SOCKET_DATAGRAM_TRUESIZE)
+            {
+                fprintf(stderr, "Burst target invalid.");
+                display_help_message();
+            }
+            break;
+        case 'o':
+            if (strcmp(optarg, "refuse") == 0)
+            {
+                overload_action = DNS_OVERLOAD_REFUSE;
+            }
+            else if (strcmp(optarg, "drop") == 0)
+            {
+                overload_action = DNS_OVERLOAD_DROP;
+            }
+            else
+            {
+                fprintf(stderr, "Overload action invalid.");
+                display_help_message();
+            }
+            break;
         default:
             display_help_message();
             break;
         }
     }
-    // Initialize socket on given port, and run loop for incoming messages.
-    initialize_data_processing(portnum, default_address_response);
+    // Compiling patterns needs nothing else, so skip loading the lists.
+    if (compiled_pattern_path)
+    {
+        if (command_line->patterns == NULL)
+        {
+            fprintf(stderr, "No pattern file to compile.");
+            display_help_message();
+        }
+        struct dns_pattern_stats pattern_stats;
+        dns_pattern_load(&listeners[0].patterns, command_line->patterns, &pattern_stats);
+        dns_pattern_print_stats(&pattern_stats, stderr);
+        dns_pattern_save(&listeners[0].patterns, compiled_pattern_path);
+        return 0;
+    }
+
+    // A configuration file replaces the listener of the command line.
+    if (config_path)
+    {
+        if (listener_options)
+        {
+            fprintf(stderr, "Listener options cannot be combined with -c.");
+            display_help_message();
+        }
+        dns_config_load(&listener_config, config_path);
+    }
+    else
+    {
+        listener_config.listener_count = 1;
+    }
+    listener_count = listener_config.listener_count + (unix_listener.path != NULL);
+    if (handoff_path && listener_count * worker_count > DNS_HANDOFF_MAX_SOCKETS)
+    {
+        fprintf(stderr, "A handoff passes at most %d sockets, one per listener and worker.", DNS_HANDOFF_MAX_SOCKETS);
+        display_help_message();
+    }
+    if (arena_flags && memory_budget == 0)
+    {
+        fprintf(stderr, "--hugepages and --lock-memory need --max-memory.");
+        display_help_message();
+    }
+    dns_arena_init(&arena, memory_budget, arena_flags);
+    allocate_workers();
+    for (int listener = 0; listener < listener_config.listener_count; listener++)
+    {
+        setup_listener(&listeners[listener], &listener_config.listeners[listener], list_threads);
+        if (memory_budget)
+        {
+            move_listener_to_arena(&listeners[listener]);
+        }
+    }
+    if (memory_budget)
+    {
+        dns_arena_print(&arena, stderr);
+    }
+
+    // The Unix socket answers with the policy of the command line listener,
+    // whose tables it shares rather than loading them again.
+    if (unix_listener.path)
+    {
+        listeners[1] = listeners[0];
+        listeners[1].port = unix_listener.port;
+        listeners[1].family = unix_listener.family;
+        listeners[1].path = unix_listener.path;
+    }
+
+    // Initialize sockets on every listener, and run loops for incoming messages.
+    initialize_data_processing(handoff_path);
     return 0;
 }
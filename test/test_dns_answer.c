@@ -0,0 +1,173 @@
+/**
+ * Test the functions associated with the dns_answer module that rotates
+ * answers over weighted sets of addresses.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "CUnit/Basic.h"
+
+// Include files needed from sources.
+#include "../src/dns_answer.h"
+#include "../src/dns_defns.h"
+#include "../src/dns_manager.h"
+#include "test_suites.h"
+
+// A query for the AAAA record of google.com, and the offset of its type.
+static const uint8_t answer_test_query[] = {
+    0x10, 0x32, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x06, 0x67, 0x6f, 0x6f,
+    0x67, 0x6c, 0x65, 0x03, 0x63, 0x6f, 0x6d, 0x00,
+    0x00, 0x1c, 0x00, 0x01};
+#define ANSWER_TEST_TYPE_POSITION 25
+
+/**
+ * Start the DNS answer test suite.
+ */
+int initialize_dns_answer_test_suite(void)
+{
+    fprintf(stdout, "\nStarting DNS Answer Tests.");
+    return 0;
+}
+
+/**
+ * Close down the DNS answer test suite.
+ */
+int cleanup_dns_answer_test_suite(void)
+{
+    fprintf(stdout, "\nCompleting DNS Answer Tests.");
+    return 0;
+}
+
+/**
+ * Test that addresses and weights are validated and that the set is bounded.
+ */
+void test_dns_answer_add(void)
+{
+    struct dns_answer_set set;
+    dns_answer_init(&set);
+    CU_ASSERT_TRUE(dns_answer_add(&set, "10.0.0.1"));
+    CU_ASSERT_TRUE(dns_answer_add(&set, "2001:db8::1@16"));
+    CU_ASSERT_FALSE(dns_answer_add(&set, "10.0.0.2@0"));
+    CU_ASSERT_FALSE(dns_answer_add(&set, "10.0.0.2@17"));
+    CU_ASSERT_FALSE(dns_answer_add(&set, "10.0.0.2@"));
+    CU_ASSERT_FALSE(dns_answer_add(&set, "example.com"));
+    CU_ASSERT_EQUAL(1, set.a.count);
+    CU_ASSERT_EQUAL(1, set.aaaa.count);
+    CU_ASSERT_EQUAL(16, set.aaaa.weights[0]);
+
+    for (int i = 1; i < DNS_ANSWER_MAX_ADDRESSES; i++)
+    {
+        CU_ASSERT_TRUE(dns_answer_add(&set, "10.0.0.3"));
+    }
+    CU_ASSERT_FALSE(dns_answer_add(&set, "10.0.0.4"));
+}
+
+/**
+ * Test that each address leads the answer in proportion to its weight, spread
+ * over the rotation, and that every slot holds every address once.
+ */
+void test_dns_answer_rotation(void)
+{
+    struct dns_answer_set set;
+    dns_answer_init(&set);
+    dns_answer_add(&set, "10.0.0.1@3");
+    dns_answer_add(&set, "10.0.0.2");
+    dns_answer_add(&set, "2001:db8::1");
+    dns_answer_add(&set, "2001:db8::2");
+    dns_answer_compile(&set);
+    CU_ASSERT_EQUAL(4, set.a.slot_count);
+    CU_ASSERT_EQUAL(2, set.aaaa.slot_count);
+    CU_ASSERT_EQUAL(4, dns_answer_period(&set));
+
+    // Smooth weighted round-robin leads with 1, 1, 2, 1.
+    const uint8_t leaders[] = {1, 1, 2, 1};
+    for (uint32_t rotation = 0; rotation < 8; rotation++)
+    {
+        uint8_t message[DNS_UDP_MAX_SIZE];
+        ssize_t size = DNS_HEADER_SIZE;
+        CU_ASSERT_EQUAL(2, dns_answer_append(&set, DNS_RR_TYPE_A, rotation, DNS_HEADER_SIZE, message, &size));
+        CU_ASSERT_EQUAL(DNS_HEADER_SIZE + 2 * DNS_ANSWER_A_SIZE, size);
+        CU_ASSERT_EQUAL(leaders[rotation % 4], message[DNS_HEADER_SIZE + DNS_ANSWER_A_SIZE - 1]);
+        CU_ASSERT_EQUAL(3 - leaders[rotation % 4], message[DNS_HEADER_SIZE + 2 * DNS_ANSWER_A_SIZE - 1]);
+    }
+    dns_answer_free(&set);
+}
+
+/**
+ * Test that AAAA and ANY questions are answered from the set, that a full
+ * message is truncated, and that AAAA questions are not implemented without
+ * IPv6 addresses.
+ */
+void test_dns_answer_parse(void)
+{
+    uint8_t message[DNS_UDP_MAX_SIZE];
+    struct dns_answer_set set;
+    dns_answer_init(&set);
+    dns_answer_add(&set, "10.0.0.1");
+    dns_answer_add(&set, "2001:db8::1");
+    dns_answer_add(&set, "2001:db8::2");
+    dns_answer_compile(&set);
+    struct dns_answer_policy policy = {.address = inet_addr("10.0.0.1"), .answers = &set, .rotation = 1};
+
+    memcpy(message, answer_test_query, sizeof(answer_test_query));
+    ssize_t size = parse_message(message, sizeof(answer_test_query), &policy);
+    CU_ASSERT_EQUAL(sizeof(answer_test_query) + 2 * DNS_ANSWER_AAAA_SIZE, size);
+    CU_ASSERT_EQUAL(2, get_dns_ancount(message));
+    CU_ASSERT_EQUAL(0, get_dns_flags(message) & (DNS_FLAG_RCODE_MASK | DNS_FLAG_TC));
+    CU_ASSERT_EQUAL(0xC0, message[sizeof(answer_test_query)]);
+    CU_ASSERT_EQUAL(DNS_HEADER_SIZE, message[sizeof(answer_test_query) + 1]);
+    CU_ASSERT_EQUAL(DNS_RR_TYPE_AAAA, message[sizeof(answer_test_query) + 3]);
+    CU_ASSERT_EQUAL(2, message[sizeof(answer_test_query) + DNS_ANSWER_AAAA_SIZE - 1]);
+
+    memcpy(message, answer_test_query, sizeof(answer_test_query));
+    message[ANSWER_TEST_TYPE_POSITION] = DNS_RR_TYPE_ANY;
+    size = parse_message(message, sizeof(answer_test_query), &policy);
+    CU_ASSERT_EQUAL(sizeof(answer_test_query) + DNS_ANSWER_A_SIZE + 2 * DNS_ANSWER_AAAA_SIZE, size);
+    CU_ASSERT_EQUAL(3, get_dns_ancount(message));
+
+    // Fill the set so that two ANY questions do not fit in one message.
+    for (int i = 1; i < DNS_ANSWER_MAX_ADDRESSES; i++)
+    {
+        dns_answer_add(&set, "10.0.0.2");
+    }
+    for (int i = 2; i < DNS_ANSWER_MAX_ADDRESSES; i++)
+    {
+        dns_answer_add(&set, "2001:db8::3");
+    }
+    dns_answer_compile(&set);
+    uint16_t question_size = sizeof(answer_test_query) - DNS_HEADER_SIZE;
+    memcpy(message, answer_test_query, sizeof(answer_test_query));
+    memcpy(message + sizeof(answer_test_query), answer_test_query + DNS_HEADER_SIZE, question_size);
+    message[ANSWER_TEST_TYPE_POSITION] = DNS_RR_TYPE_ANY;
+    message[ANSWER_TEST_TYPE_POSITION + question_size] = DNS_RR_TYPE_ANY;
+    set_dns_qdcount(message, 2);
+    size = parse_message(message, sizeof(answer_test_query) + question_size, &policy);
+    CU_ASSERT_EQUAL(2 * DNS_ANSWER_MAX_ADDRESSES, get_dns_ancount(message));
+    CU_ASSERT_EQUAL(DNS_FLAG_TC, get_dns_flags(message) & DNS_FLAG_TC);
+    CU_ASSERT_TRUE(size <= DNS_UDP_MAX_SIZE);
+    dns_answer_free(&set);
+
+    // Without IPv6 addresses, AAAA questions are not implemented.
+    policy.answers = NULL;
+    memcpy(message, answer_test_query, sizeof(answer_test_query));
+    parse_message(message, sizeof(answer_test_query), &policy);
+    CU_ASSERT_EQUAL(DNS_FLAG_RCODE_NOT_IMPLEMENTED, get_dns_flags(message) & DNS_FLAG_RCODE_MASK);
+}
+
+int add_dns_answer_test_suite(void)
+{
+    CU_pSuite answerSuite = CU_add_suite("DNS Answer Tests", initialize_dns_answer_test_suite, cleanup_dns_answer_test_suite);
+    if (NULL == answerSuite)
+    {
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(answerSuite, "Test of dns_answer_add function", test_dns_answer_add)) ||
+        (NULL == CU_add_test(answerSuite, "Test of dns_answer_compile and dns_answer_append functions", test_dns_answer_rotation)) ||
+        (NULL == CU_add_test(answerSuite, "Test of answering from a set in add_answers", test_dns_answer_parse)))
+    {
+        return CU_get_error();
+    }
+    return CUE_SUCCESS;
+}
@@ -0,0 +1,171 @@
+/**
+ * Test the functions associated with the dns_any module that answers ANY
+ * queries with minimal RFC 8482 replies.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "CUnit/Basic.h"
+
+// Include files needed from sources.
+#include "../src/dns_any.h"
+#include "../src/dns_defns.h"
+#include "../src/dns_manager.h"
+#include "test_suites.h"
+
+// A query for the ANY records of google.com.
+static const uint8_t any_test_query[] = {
+    0x10, 0x32, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x06, 0x67, 0x6f, 0x6f,
+    0x67, 0x6c, 0x65, 0x03, 0x63, 0x6f, 0x6d, 0x00,
+    0x00, 0xff, 0x00, 0x01};
+#define ANY_TEST_TYPE_POSITION 25
+
+/**
+ * Start the DNS any test suite.
+ */
+int initialize_dns_any_test_suite(void)
+{
+    fprintf(stdout, "\nStarting DNS Any Tests.");
+    return 0;
+}
+
+/**
+ * Close down the DNS any test suite.
+ */
+int cleanup_dns_any_test_suite(void)
+{
+    fprintf(stdout, "\nCompleting DNS Any Tests.");
+    return 0;
+}
+
+/**
+ * Test that the mode names are parsed.
+ */
+void test_dns_any_parse_mode(void)
+{
+    enum dns_any_mode mode = DNS_ANY_ANSWER;
+    CU_ASSERT_TRUE(dns_any_parse_mode("hinfo", &mode));
+    CU_ASSERT_EQUAL(DNS_ANY_HINFO, mode);
+    CU_ASSERT_TRUE(dns_any_parse_mode("truncate", &mode));
+    CU_ASSERT_EQUAL(DNS_ANY_TRUNCATE, mode);
+    CU_ASSERT_TRUE(dns_any_parse_mode("answer", &mode));
+    CU_ASSERT_EQUAL(DNS_ANY_ANSWER, mode);
+    CU_ASSERT_FALSE(dns_any_parse_mode("refuse", &mode));
+}
+
+/**
+ * Test that each mode builds its reply to an ANY query, and that A queries
+ * are answered as before whatever the mode.
+ */
+void test_dns_any_parse(void)
+{
+    static const uint8_t hinfo_data[] = {7, 'R', 'F', 'C', '8', '4', '8', '2', 0};
+    uint8_t message[DNS_UDP_MAX_SIZE];
+    struct dns_answer_policy policy = {.address = inet_addr("6.6.6.6"), .any = DNS_ANY_ANSWER};
+
+    // Answered like an A query by default.
+    memcpy(message, any_test_query, sizeof(any_test_query));
+    ssize_t size = parse_message(message, sizeof(any_test_query), &policy);
+    CU_ASSERT_EQUAL(sizeof(any_test_query) + DNS_ANSWER_A_SIZE, size);
+    CU_ASSERT_EQUAL(1, get_dns_ancount(message));
+
+    // A single HINFO record naming the RFC.
+    policy.any = DNS_ANY_HINFO;
+    memcpy(message, any_test_query, sizeof(any_test_query));
+    size = parse_message(message, sizeof(any_test_query), &policy);
+    CU_ASSERT_FATAL(sizeof(any_test_query) + DNS_ANY_HINFO_SIZE == size);
+    CU_ASSERT_EQUAL(1, get_dns_ancount(message));
+    CU_ASSERT_EQUAL(0, get_dns_flags(message) & (DNS_FLAG_RCODE_MASK | DNS_FLAG_TC));
+    uint8_t *record = message + sizeof(any_test_query);
+    CU_ASSERT_EQUAL(0xC0, record[0]);
+    CU_ASSERT_EQUAL(DNS_HEADER_SIZE, record[1]);
+    CU_ASSERT_EQUAL(DNS_RR_TYPE_HINFO, record[3]);
+    CU_ASSERT_EQUAL(sizeof(hinfo_data), record[11]);
+    CU_ASSERT_EQUAL(0, memcmp(record + 12, hinfo_data, sizeof(hinfo_data)));
+
+    // No answers and the truncation flag.
+    policy.any = DNS_ANY_TRUNCATE;
+    memcpy(message, any_test_query, sizeof(any_test_query));
+    size = parse_message(message, sizeof(any_test_query), &policy);
+    CU_ASSERT_EQUAL(sizeof(any_test_query), size);
+    CU_ASSERT_EQUAL(0, get_dns_ancount(message));
+    CU_ASSERT_EQUAL(DNS_FLAG_TC | DNS_FLAG_QR, get_dns_flags(message) & (DNS_FLAG_TC | DNS_FLAG_QR));
+
+    // A queries are left alone.
+    memcpy(message, any_test_query, sizeof(any_test_query));
+    message[ANY_TEST_TYPE_POSITION] = DNS_RR_TYPE_A;
+    size = parse_message(message, sizeof(any_test_query), &policy);
+    CU_ASSERT_EQUAL(sizeof(any_test_query) + DNS_ANSWER_A_SIZE, size);
+    CU_ASSERT_EQUAL(0, get_dns_flags(message) & DNS_FLAG_TC);
+}
+
+/**
+ * Answer the test query with a policy and count the reply.
+ */
+static void any_test_count(struct dns_any_stats *stats, const struct dns_answer_policy *policy)
+{
+    uint8_t message[DNS_UDP_MAX_SIZE];
+    memcpy(message, any_test_query, sizeof(any_test_query));
+    ssize_t size = parse_message(message, sizeof(any_test_query), policy);
+    dns_any_count(stats, message, sizeof(any_test_query), size);
+}
+
+/**
+ * Test that only ANY queries are counted, by the reply they were answered
+ * with rather than the mode.
+ */
+void test_dns_any_count(void)
+{
+    struct dns_any_stats stats;
+    struct dns_table table;
+    struct dns_answer_policy policy = {.address = inet_addr("6.6.6.6"), .any = DNS_ANY_HINFO};
+    memset(&stats, 0, sizeof(stats));
+
+    any_test_count(&stats, &policy);
+    policy.any = DNS_ANY_TRUNCATE;
+    any_test_count(&stats, &policy);
+    policy.any = DNS_ANY_ANSWER;
+    any_test_count(&stats, &policy);
+    CU_ASSERT_EQUAL(3, stats.queries);
+    CU_ASSERT_EQUAL(1, stats.hinfo);
+    CU_ASSERT_EQUAL(1, stats.truncated);
+    CU_ASSERT_EQUAL(1, stats.answered);
+    CU_ASSERT_EQUAL(3 * sizeof(any_test_query) + DNS_ANY_HINFO_SIZE + DNS_ANSWER_A_SIZE, stats.response_bytes);
+
+    // A name missing from the list gets an error without a HINFO record,
+    // which counts as answered whatever the mode.
+    dns_table_init(&table, 0);
+    policy.table = &table;
+    policy.any = DNS_ANY_HINFO;
+    any_test_count(&stats, &policy);
+    CU_ASSERT_EQUAL(1, stats.hinfo);
+    CU_ASSERT_EQUAL(2, stats.answered);
+    dns_table_free(&table);
+
+    // Neither other types nor questions cut short are counted.
+    uint8_t message[sizeof(any_test_query)];
+    memcpy(message, any_test_query, sizeof(any_test_query));
+    message[ANY_TEST_TYPE_POSITION] = DNS_RR_TYPE_A;
+    dns_any_count(&stats, message, sizeof(message), sizeof(message));
+    message[ANY_TEST_TYPE_POSITION] = DNS_RR_TYPE_ANY;
+    dns_any_count(&stats, message, ANY_TEST_TYPE_POSITION, ANY_TEST_TYPE_POSITION);
+    CU_ASSERT_EQUAL(4, stats.queries);
+}
+
+int add_dns_any_test_suite(void)
+{
+    CU_pSuite anySuite = CU_add_suite("DNS Any Tests", initialize_dns_any_test_suite, cleanup_dns_any_test_suite);
+    if (NULL == anySuite)
+    {
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(anySuite, "Test of dns_any_parse_mode function", test_dns_any_parse_mode)) ||
+        (NULL == CU_add_test(anySuite, "Test of ANY modes in add_answers", test_dns_any_parse)) ||
+        (NULL == CU_add_test(anySuite, "Test of dns_any_count function", test_dns_any_count)))
+    {
+        return CU_get_error();
+    }
+    return CUE_SUCCESS;
+}
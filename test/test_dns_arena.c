@@ -0,0 +1,127 @@
+/**
+ * Test the functions associated with the dns_arena module that carves the
+ * runtime state from a fixed memory budget.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CUnit/Basic.h"
+
+// Include files needed from sources.
+#include "../src/dns_arena.h"
+#include "test_suites.h"
+
+/**
+ * Start the DNS arena test suite.
+ */
+int initialize_dns_arena_test_suite(void)
+{
+    fprintf(stdout, "\nStarting DNS Arena Tests.");
+    return 0;
+}
+
+/**
+ * Close down the DNS arena test suite.
+ */
+int cleanup_dns_arena_test_suite(void)
+{
+    fprintf(stdout, "\nCompleting DNS Arena Tests.");
+    return 0;
+}
+
+/**
+ * Test that sizes are parsed with and without a suffix.
+ */
+void test_dns_arena_parse_size(void)
+{
+    CU_ASSERT_EQUAL(4096, dns_arena_parse_size("4096"));
+    CU_ASSERT_EQUAL(64 << 10, dns_arena_parse_size("64K"));
+    CU_ASSERT_EQUAL(3 << 20, dns_arena_parse_size("3m"));
+    CU_ASSERT_EQUAL((size_t)2 << 30, dns_arena_parse_size("2G"));
+    CU_ASSERT_EQUAL(0, dns_arena_parse_size("12Q"));
+    CU_ASSERT_EQUAL(0, dns_arena_parse_size("M"));
+    CU_ASSERT_EQUAL(0, dns_arena_parse_size("1MB"));
+}
+
+/**
+ * Test that blocks are carved zeroed, aligned and in order from the budget,
+ * and that the breakdown adds up blocks of the same use.
+ */
+void test_dns_arena_alloc(void)
+{
+    struct dns_arena arena;
+    dns_arena_init(&arena, 1 << 20, 0);
+    CU_ASSERT_FATAL(arena.base != NULL);
+    CU_ASSERT_EQUAL(1 << 20, arena.size);
+
+    uint8_t *first = dns_arena_alloc(&arena, 100, "buffers");
+    uint8_t *second = dns_arena_alloc(&arena, 10, "buffers");
+    const char data[] = "table";
+    char *copy = dns_arena_copy(&arena, data, sizeof(data), "tables");
+    CU_ASSERT_TRUE(arena.base == first);
+    CU_ASSERT_TRUE(first + 128 == second);
+    CU_ASSERT_EQUAL(0, (uintptr_t)copy % DNS_ARENA_ALIGNMENT);
+    CU_ASSERT_STRING_EQUAL("table", copy);
+    CU_ASSERT_EQUAL(0, second[9]);
+    CU_ASSERT_EQUAL(128 + 64 + 64, arena.used);
+
+    CU_ASSERT_FATAL(2 == arena.use_count);
+    CU_ASSERT_STRING_EQUAL("buffers", arena.uses[0].name);
+    CU_ASSERT_EQUAL(192, arena.uses[0].size);
+    CU_ASSERT_EQUAL(2, arena.uses[0].blocks);
+    CU_ASSERT_EQUAL(64, arena.uses[1].size);
+    dns_arena_free(&arena);
+    CU_ASSERT_PTR_NULL(arena.base);
+}
+
+/**
+ * Test that without a budget blocks still come aligned and zeroed, and are
+ * still accounted for.
+ */
+void test_dns_arena_heap(void)
+{
+    struct dns_arena arena;
+    dns_arena_init(&arena, 0, 0);
+    CU_ASSERT_PTR_NULL(arena.base);
+    uint8_t *block = dns_arena_alloc(&arena, 1000, "buffers");
+    CU_ASSERT_FATAL(block != NULL);
+    CU_ASSERT_EQUAL(0, (uintptr_t)block % DNS_ARENA_ALIGNMENT);
+    CU_ASSERT_EQUAL(0, block[999]);
+    CU_ASSERT_EQUAL(1024, arena.used);
+    CU_ASSERT_EQUAL(1, arena.use_count);
+    free(block);
+}
+
+/**
+ * Test that the budget stays as requested when huge pages round the mapping
+ * up, whether or not any are reserved.
+ */
+void test_dns_arena_hugepages(void)
+{
+    struct dns_arena arena;
+    dns_arena_init(&arena, 3 << 20, DNS_ARENA_HUGEPAGES);
+    CU_ASSERT_FATAL(arena.base != NULL);
+    CU_ASSERT_EQUAL(3 << 20, arena.size);
+    CU_ASSERT_EQUAL(arena.hugepages ? 4 << 20 : 3 << 20, arena.mapped_size);
+    dns_arena_free(&arena);
+}
+
+int add_dns_arena_test_suite(void)
+{
+    CU_pSuite arenaSuite = CU_add_suite("DNS Arena Tests", initialize_dns_arena_test_suite, cleanup_dns_arena_test_suite);
+    if (NULL == arenaSuite)
+    {
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(arenaSuite, "Test of dns_arena_parse_size function", test_dns_arena_parse_size)) ||
+        (NULL == CU_add_test(arenaSuite, "Test of dns_arena_alloc and dns_arena_copy functions", test_dns_arena_alloc)) ||
+        (NULL == CU_add_test(arenaSuite, "Test of dns_arena_alloc without a budget", test_dns_arena_heap)) ||
+        (NULL == CU_add_test(arenaSuite, "Test of dns_arena_init with huge pages", test_dns_arena_hugepages)))
+    {
+        return CU_get_error();
+    }
+    return CUE_SUCCESS;
+}
@@ -0,0 +1,112 @@
+/**
+ * Test the functions associated with the dns_batch module that checks and
+ * answers a batch of packets together.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "CUnit/Basic.h"
+
+// Include files needed from sources.
+#include "../src/dns_batch.h"
+#include "../src/dns_defns.h"
+#include "../src/dns_manager.h"
+#include "test_suites.h"
+
+// A query for the A record of google.com.
+static const uint8_t batch_test_query[] = {
+    0x10, 0x32, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x06, 0x67, 0x6f, 0x6f,
+    0x67, 0x6c, 0x65, 0x03, 0x63, 0x6f, 0x6d, 0x00,
+    0x00, 0x01, 0x00, 0x01};
+
+// The number of packets in the test batch, more than one vector of lanes.
+#define BATCH_TEST_PACKETS 20
+
+/**
+ * Start the DNS batch test suite.
+ */
+int initialize_dns_batch_test_suite(void)
+{
+    fprintf(stdout, "\nStarting DNS Batch Tests.");
+    return 0;
+}
+
+/**
+ * Close down the DNS batch test suite.
+ */
+int cleanup_dns_batch_test_suite(void)
+{
+    fprintf(stdout, "\nCompleting DNS Batch Tests.");
+    return 0;
+}
+
+/**
+ * Test that only standard queries pass the checks, and that every packet of
+ * the batch is answered exactly as parse_message() answers it.
+ */
+void test_dns_batch_parse(void)
+{
+    static uint8_t packets[BATCH_TEST_PACKETS][DNS_UDP_MAX_SIZE];
+    static uint8_t expected[BATCH_TEST_PACKETS][DNS_UDP_MAX_SIZE];
+    static struct dns_batch batch;
+    uint8_t *messages[BATCH_TEST_PACKETS];
+    ssize_t sizes[BATCH_TEST_PACKETS];
+    struct dns_answer_policy policy = {.address = inet_addr("6.6.6.6")};
+
+    for (int i = 0; i < BATCH_TEST_PACKETS; i++)
+    {
+        memcpy(packets[i], batch_test_query, sizeof(batch_test_query));
+        messages[i] = packets[i];
+        sizes[i] = sizeof(batch_test_query);
+    }
+    // Break every check on some packets, the last one lands in the second
+    // vector of lanes.
+    set_dns_flags(packets[1], get_dns_flags(packets[1]) | DNS_FLAG_QR);
+    set_dns_flags(packets[2], get_dns_flags(packets[2]) | 0x1000); // Status opcode.
+    set_dns_qdcount(packets[3], 0);
+    set_dns_qdcount(packets[4], DNS_MAX_QUESTIONS + 1);
+    set_dns_ancount(packets[5], 1);
+    set_dns_nscount(packets[6], 1);
+    sizes[7] = DNS_HEADER_SIZE - 1;
+    set_dns_ancount(packets[BATCH_TEST_PACKETS - 1], 2);
+
+    dns_batch_load(&batch, messages, sizes, BATCH_TEST_PACKETS);
+    CU_ASSERT_EQUAL(BATCH_TEST_PACKETS, batch.count);
+    CU_ASSERT_TRUE(batch.valid[0]);
+    for (int i = 1; i <= 7; i++)
+    {
+        CU_ASSERT_FALSE(batch.valid[i]);
+    }
+    CU_ASSERT_TRUE(batch.valid[8]);
+    CU_ASSERT_FALSE(batch.valid[BATCH_TEST_PACKETS - 1]);
+    CU_ASSERT_FALSE(batch.valid[BATCH_TEST_PACKETS]);
+
+    // Skip the short packet, which is dropped before it is parsed.
+    memcpy(expected, packets, sizeof(expected));
+    for (int i = 0; i < BATCH_TEST_PACKETS; i++)
+    {
+        if (i == 7)
+        {
+            continue;
+        }
+        ssize_t expected_size = parse_message(expected[i], sizes[i], &policy);
+        CU_ASSERT_EQUAL(expected_size, dns_batch_parse(&batch, i, &policy));
+        CU_ASSERT_EQUAL(0, memcmp(expected[i], packets[i], DNS_UDP_MAX_SIZE));
+    }
+}
+
+int add_dns_batch_test_suite(void)
+{
+    CU_pSuite batchSuite = CU_add_suite("DNS Batch Tests", initialize_dns_batch_test_suite, cleanup_dns_batch_test_suite);
+    if (NULL == batchSuite)
+    {
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(batchSuite, "Test of dns_batch_load and dns_batch_parse functions", test_dns_batch_parse)))
+    {
+        return CU_get_error();
+    }
+    return CUE_SUCCESS;
+}
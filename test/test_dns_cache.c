@@ -0,0 +1,169 @@
+/**
+ * Test the functions associated with the dns_cache module that answers
+ * repeated questions from previously generated responses.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "CUnit/Basic.h"
+
+// Include files needed from sources.
+#include "../src/dns_cache.h"
+#include "../src/dns_defns.h"
+#include "../src/dns_manager.h"
+#include "test_suites.h"
+
+// A query for the A record of google.com.
+static const uint8_t cache_test_query[] = {
+    0x10, 0x32, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x06, 0x67, 0x6f, 0x6f,
+    0x67, 0x6c, 0x65, 0x03, 0x63, 0x6f, 0x6d, 0x00,
+    0x00, 0x01, 0x00, 0x01};
+
+// The cache under test, large enough that it should not live on the stack.
+static struct dns_cache test_cache;
+
+/**
+ * Start the DNS cache test suite.
+ */
+int initialize_dns_cache_test_suite(void)
+{
+    fprintf(stdout, "\nStarting DNS Cache Tests.");
+    dns_cache_init(&test_cache);
+    return 0;
+}
+
+/**
+ * Close down the DNS cache test suite.
+ */
+int cleanup_dns_cache_test_suite(void)
+{
+    fprintf(stdout, "\nCompleting DNS Cache Tests.");
+    return 0;
+}
+
+/**
+ * Test that a repeated question misses once, then hits and produces the same
+ * response as parse_message() with the new query's ID.
+ */
+void test_dns_cache_hit(void)
+{
+    struct dns_answer_policy policy = {.address = inet_addr("6.6.6.6")};
+    uint8_t expected[DNS_UDP_MAX_SIZE];
+    uint8_t message[DNS_UDP_MAX_SIZE];
+
+    // The first query misses and its response is inserted.
+    memcpy(message, cache_test_query, sizeof(cache_test_query));
+    CU_ASSERT_EQUAL(0, dns_cache_lookup(&test_cache, message, sizeof(cache_test_query), 0));
+    ssize_t response_size = parse_message(message, sizeof(cache_test_query), &policy);
+    dns_cache_insert(&test_cache, message, response_size);
+    CU_ASSERT_EQUAL(1, test_cache.insertions);
+
+    // Build the expected response for a query with a different ID.
+    memcpy(expected, cache_test_query, sizeof(cache_test_query));
+    set_dns_id(expected, 0x4242);
+    parse_message(expected, sizeof(cache_test_query), &policy);
+
+    // The second query hits and matches the freshly parsed response.
+    memcpy(message, cache_test_query, sizeof(cache_test_query));
+    set_dns_id(message, 0x4242);
+    CU_ASSERT_EQUAL(response_size, dns_cache_lookup(&test_cache, message, sizeof(cache_test_query), 0));
+    CU_ASSERT_EQUAL(0, memcmp(expected, message, response_size));
+    CU_ASSERT_EQUAL(1, test_cache.hits);
+
+    // The same question in another variant misses.
+    memcpy(message, cache_test_query, sizeof(cache_test_query));
+    CU_ASSERT_EQUAL(0, dns_cache_lookup(&test_cache, message, sizeof(cache_test_query), 1));
+    CU_ASSERT_EQUAL(1, test_cache.hits);
+}
+
+/**
+ * Test that a truncated response keeps its truncation flag when answered from
+ * the cache.
+ */
+void test_dns_cache_truncated(void)
+{
+    struct dns_answer_policy policy = {.address = inet_addr("6.6.6.6"), .any = DNS_ANY_TRUNCATE};
+    uint8_t message[DNS_UDP_MAX_SIZE];
+
+    memcpy(message, cache_test_query, sizeof(cache_test_query));
+    message[sizeof(cache_test_query) - 3] = DNS_RR_TYPE_ANY;
+    CU_ASSERT_EQUAL(0, dns_cache_lookup(&test_cache, message, sizeof(cache_test_query), 2));
+    ssize_t response_size = parse_message(message, sizeof(cache_test_query), &policy);
+    dns_cache_insert(&test_cache, message, response_size);
+
+    memcpy(message, cache_test_query, sizeof(cache_test_query));
+    message[sizeof(cache_test_query) - 3] = DNS_RR_TYPE_ANY;
+    CU_ASSERT_EQUAL(response_size, dns_cache_lookup(&test_cache, message, sizeof(cache_test_query), 2));
+    CU_ASSERT_EQUAL(DNS_FLAG_TC, get_dns_flags(message) & DNS_FLAG_TC);
+}
+
+/**
+ * Test that answers cut short because they do not fit in a UDP message are
+ * still marked truncated when answered from the cache.
+ */
+void test_dns_cache_truncated_answers(void)
+{
+    struct dns_answer_set set;
+    dns_answer_init(&set);
+    for (int i = 0; i < DNS_ANSWER_MAX_ADDRESSES; i++)
+    {
+        dns_answer_add(&set, "10.0.0.1");
+        dns_answer_add(&set, "2001:db8::1");
+    }
+    dns_answer_compile(&set);
+    struct dns_answer_policy policy = {.address = inet_addr("10.0.0.1"), .answers = &set};
+
+    // Two ANY questions for every address do not fit in one message.
+    uint8_t query[DNS_UDP_MAX_SIZE];
+    uint16_t question_size = sizeof(cache_test_query) - DNS_HEADER_SIZE;
+    memcpy(query, cache_test_query, sizeof(cache_test_query));
+    memcpy(query + sizeof(cache_test_query), cache_test_query + DNS_HEADER_SIZE, question_size);
+    query[sizeof(cache_test_query) - 3] = DNS_RR_TYPE_ANY;
+    query[sizeof(cache_test_query) + question_size - 3] = DNS_RR_TYPE_ANY;
+    set_dns_qdcount(query, 2);
+    ssize_t query_size = sizeof(cache_test_query) + question_size;
+
+    uint8_t expected[DNS_UDP_MAX_SIZE];
+    uint8_t message[DNS_UDP_MAX_SIZE];
+    memcpy(expected, query, query_size);
+    CU_ASSERT_EQUAL(0, dns_cache_lookup(&test_cache, expected, query_size, 3));
+    ssize_t response_size = parse_message(expected, query_size, &policy);
+    CU_ASSERT_EQUAL(DNS_FLAG_TC, get_dns_flags(expected) & DNS_FLAG_TC);
+    dns_cache_insert(&test_cache, expected, response_size);
+
+    memcpy(message, query, query_size);
+    CU_ASSERT_EQUAL(response_size, dns_cache_lookup(&test_cache, message, query_size, 3));
+    CU_ASSERT_EQUAL(DNS_FLAG_TC, get_dns_flags(message) & DNS_FLAG_TC);
+    CU_ASSERT_EQUAL(0, memcmp(expected, message, response_size));
+    dns_answer_free(&set);
+}
+
+/**
+ * Test that a message with the QR flag set is never answered from the cache.
+ */
+void test_dns_cache_skips_responses(void)
+{
+    uint8_t message[DNS_UDP_MAX_SIZE];
+    memcpy(message, cache_test_query, sizeof(cache_test_query));
+    set_dns_flags(message, get_dns_flags(message) | DNS_FLAG_QR);
+    CU_ASSERT_EQUAL(0, dns_cache_lookup(&test_cache, message, sizeof(cache_test_query), 0));
+}
+
+int add_dns_cache_test_suite(void)
+{
+    CU_pSuite cacheSuite = CU_add_suite("DNS Cache Tests", initialize_dns_cache_test_suite, cleanup_dns_cache_test_suite);
+    if (NULL == cacheSuite)
+    {
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(cacheSuite, "Test of dns_cache_lookup hit", test_dns_cache_hit)) ||
+        (NULL == CU_add_test(cacheSuite, "Test of dns_cache_lookup on truncated responses", test_dns_cache_truncated)) ||
+        (NULL == CU_add_test(cacheSuite, "Test of dns_cache_lookup on answers cut short", test_dns_cache_truncated_answers)) ||
+        (NULL == CU_add_test(cacheSuite, "Test of dns_cache_lookup on responses", test_dns_cache_skips_responses)))
+    {
+        return CU_get_error();
+    }
+    return CUE_SUCCESS;
+}
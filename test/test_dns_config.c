@@ -0,0 +1,120 @@
+/**
+ * Test the functions associated with the dns_config module that loads the
+ * listeners of a configuration file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "CUnit/Basic.h"
+
+// Include files needed from sources.
+#include "../src/dns_config.h"
+#include "test_suites.h"
+
+/**
+ * Start the DNS config test suite.
+ */
+int initialize_dns_config_test_suite(void)
+{
+    fprintf(stdout, "\nStarting DNS Config Tests.");
+    return 0;
+}
+
+/**
+ * Close down the DNS config test suite.
+ */
+int cleanup_dns_config_test_suite(void)
+{
+    fprintf(stdout, "\nCompleting DNS Config Tests.");
+    return 0;
+}
+
+/**
+ * Test that options are validated before they are added to a listener.
+ */
+void test_dns_config_set(void)
+{
+    struct dns_listener_config listener;
+    char port[] = "5353", bad_port[] = "65536", family[] = "inet6", bad_family[] = "ipx";
+    char address[] = "10.0.0.1@2", bad_address[] = "10.0.0.300";
+    char any[] = "truncate", bad_any[] = "all";
+    char path[] = "/run/dns.sock", bad_path[] = "dns.sock";
+    dns_config_init_listener(&listener);
+    CU_ASSERT_EQUAL(DNS_ANY_ANSWER, listener.any);
+    CU_ASSERT_EQUAL(AF_INET, listener.family);
+    CU_ASSERT_TRUE(dns_config_set(&listener, "port", port));
+    CU_ASSERT_FALSE(dns_config_set(&listener, "port", bad_port));
+    CU_ASSERT_EQUAL(5353, listener.port);
+    CU_ASSERT_TRUE(dns_config_set(&listener, "family", family));
+    CU_ASSERT_FALSE(dns_config_set(&listener, "family", bad_family));
+    CU_ASSERT_EQUAL(AF_INET6, listener.family);
+    CU_ASSERT_TRUE(dns_config_set(&listener, "address", address));
+    CU_ASSERT_FALSE(dns_config_set(&listener, "address", bad_address));
+    CU_ASSERT_EQUAL(1, listener.address_count);
+    CU_ASSERT_TRUE(dns_config_set(&listener, "any", any));
+    CU_ASSERT_FALSE(dns_config_set(&listener, "any", bad_any));
+    CU_ASSERT_EQUAL(DNS_ANY_TRUNCATE, listener.any);
+    CU_ASSERT_FALSE(dns_config_set(&listener, "path", bad_path));
+    CU_ASSERT_TRUE(dns_config_set(&listener, "path", path));
+    CU_ASSERT_EQUAL(AF_UNIX, listener.family);
+    CU_ASSERT_FALSE(dns_config_set(&listener, "family", family));
+    CU_ASSERT_FALSE(dns_config_set(&listener, "colour", port));
+}
+
+/**
+ * Test that every listener of a file is loaded with its options, skipping
+ * comments and blank lines.
+ */
+void test_dns_config_load(void)
+{
+    char path[] = "/tmp/dns_config_testXXXXXX";
+    int file = mkstemp(path);
+    CU_ASSERT_FATAL(file >= 0);
+    const char *text = "# Two listeners.\n"
+                       "\n"
+                       "listen 53 family=inet6 address=10.0.0.1@3 address=2001:db8::1 list=a.txt list=b.txt\r\n"
+                       "  listen\t5353 patterns=p.dfa # Comment.\n"
+                       "listen /run/dns.sock address=10.0.0.2\n";
+    CU_ASSERT_FATAL(write(file, text, strlen(text)) == (ssize_t)strlen(text));
+    close(file);
+
+    struct dns_config config;
+    dns_config_load(&config, path);
+    unlink(path);
+    CU_ASSERT_FATAL(3 == config.listener_count);
+    CU_ASSERT_EQUAL(53, config.listeners[0].port);
+    CU_ASSERT_EQUAL(AF_INET6, config.listeners[0].family);
+    CU_ASSERT_EQUAL(2, config.listeners[0].address_count);
+    CU_ASSERT_STRING_EQUAL("2001:db8::1", config.listeners[0].addresses[1]);
+    CU_ASSERT_EQUAL(2, config.listeners[0].list_count);
+    CU_ASSERT_STRING_EQUAL("b.txt", config.listeners[0].lists[1]);
+    CU_ASSERT_PTR_NULL(config.listeners[0].patterns);
+    CU_ASSERT_EQUAL(5353, config.listeners[1].port);
+    CU_ASSERT_EQUAL(AF_INET, config.listeners[1].family);
+    CU_ASSERT_EQUAL(0, config.listeners[1].address_count);
+    CU_ASSERT_STRING_EQUAL("p.dfa", config.listeners[1].patterns);
+    CU_ASSERT_PTR_NULL(config.listeners[1].path);
+    CU_ASSERT_EQUAL(AF_UNIX, config.listeners[2].family);
+    CU_ASSERT_STRING_EQUAL("/run/dns.sock", config.listeners[2].path);
+    CU_ASSERT_EQUAL(1, config.listeners[2].address_count);
+    dns_config_free(&config);
+}
+
+int add_dns_config_test_suite(void)
+{
+    CU_pSuite configSuite = CU_add_suite("DNS Config Tests", initialize_dns_config_test_suite, cleanup_dns_config_test_suite);
+    if (NULL == configSuite)
+    {
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(configSuite, "Test of dns_config_set function", test_dns_config_set)) ||
+        (NULL == CU_add_test(configSuite, "Test of dns_config_load function", test_dns_config_load)))
+    {
+        return CU_get_error();
+    }
+    return CUE_SUCCESS;
+}
@@ -0,0 +1,253 @@
+/**
+ * Test the functions associated with the dns_handoff module that passes the
+ * listening sockets from a running instance to a new one.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "CUnit/Basic.h"
+
+// Include files needed from sources.
+#include "../src/dns_handoff.h"
+#include "test_suites.h"
+
+// The handoff path of the tests, unique to the process.
+static char handoff_test_path[64];
+
+/**
+ * The arguments and result of a take over run on its own thread, since it
+ * blocks until the running instance sends the sockets.
+ */
+struct handoff_test_taker
+{
+    int sockets[DNS_HANDOFF_MAX_SOCKETS + 8];
+    int max_sockets;
+    bool reject; // Leave the running instance serving instead.
+    int count;
+};
+
+/**
+ * Take over the sockets on the test path, and acknowledge them unless the
+ * taker rejects them.
+ *
+ * argument : The taker.
+ * returns  : NULL.
+ */
+static void *handoff_test_take_over(void *argument)
+{
+    struct handoff_test_taker *taker = argument;
+    int connection;
+    taker->count = handoff_take_over(handoff_test_path, taker->sockets, taker->max_sockets, &connection);
+    if (connection >= 0)
+    {
+        handoff_acknowledge(connection, !taker->reject);
+    }
+    return NULL;
+}
+
+/**
+ * Create a UDP socket bound to an ephemeral loopback port.
+ *
+ * returns : The socket.
+ */
+static int handoff_test_socket(void)
+{
+    int test_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_addr.s_addr = inet_addr("127.0.0.1")};
+    CU_ASSERT_FATAL(test_socket >= 0 && bind(test_socket, (struct sockaddr *)&address, sizeof(address)) == 0);
+    return test_socket;
+}
+
+/**
+ * Return the port a socket is bound to, which identifies the socket across
+ * descriptors.
+ *
+ * test_socket : The socket.
+ * returns     : The port, in host byte order.
+ */
+static int handoff_test_port(int test_socket)
+{
+    struct sockaddr_in address;
+    socklen_t address_size = sizeof(address);
+    if (getsockname(test_socket, (struct sockaddr *)&address, &address_size))
+    {
+        return -1;
+    }
+    return ntohs(address.sin_port);
+}
+
+/**
+ * Hand sockets over from this thread to a taker on another one.
+ *
+ * taker   : The taker, with max_sockets set.
+ * sockets : The sockets to give away.
+ * count   : The number of sockets.
+ * returns : Whether the taker acknowledged the sockets.
+ */
+static bool handoff_test_run(struct handoff_test_taker *taker, const int *sockets, int count)
+{
+    int listener = handoff_listen(handoff_test_path);
+    pthread_t thread;
+    CU_ASSERT_FATAL(pthread_create(&thread, NULL, handoff_test_take_over, taker) == 0);
+    int connection = handoff_give_away(listener, sockets, count);
+    bool complete = connection >= 0 && handoff_is_complete(connection);
+    pthread_join(thread, NULL);
+    close(listener);
+    unlink(handoff_test_path);
+    return complete;
+}
+
+/**
+ * Start the DNS handoff test suite.
+ */
+int initialize_dns_handoff_test_suite(void)
+{
+    fprintf(stdout, "\nStarting DNS Handoff Tests.");
+    snprintf(handoff_test_path, sizeof(handoff_test_path), "/tmp/dns_handoff_test_%d.sock", (int)getpid());
+    return 0;
+}
+
+/**
+ * Close down the DNS handoff test suite.
+ */
+int cleanup_dns_handoff_test_suite(void)
+{
+    fprintf(stdout, "\nCompleting DNS Handoff Tests.");
+    unlink(handoff_test_path);
+    return 0;
+}
+
+/**
+ * Test that nothing is taken over when no instance serves the path.
+ */
+void test_dns_handoff_no_instance(void)
+{
+    int sockets[1];
+    int connection;
+    unlink(handoff_test_path);
+    CU_ASSERT_EQUAL(0, handoff_take_over(handoff_test_path, sockets, 1, &connection));
+    CU_ASSERT_EQUAL(-1, connection);
+}
+
+/**
+ * Test that the sockets arrive in order as new descriptors of the same
+ * sockets, and that the giver sees the acknowledgement.
+ */
+void test_dns_handoff_sockets(void)
+{
+    int sockets[3];
+    for (int i = 0; i < 3; i++)
+    {
+        sockets[i] = handoff_test_socket();
+    }
+    struct handoff_test_taker taker = {.max_sockets = DNS_HANDOFF_MAX_SOCKETS};
+    CU_ASSERT_TRUE(handoff_test_run(&taker, sockets, 3));
+    CU_ASSERT_FATAL(3 == taker.count);
+    for (int i = 0; i < 3; i++)
+    {
+        CU_ASSERT_NOT_EQUAL(sockets[i], taker.sockets[i]);
+        CU_ASSERT_EQUAL(handoff_test_port(sockets[i]), handoff_test_port(taker.sockets[i]));
+        close(sockets[i]);
+        close(taker.sockets[i]);
+    }
+}
+
+/**
+ * Test that sockets the new instance rejects leave the running instance
+ * serving on them.
+ */
+void test_dns_handoff_rejected(void)
+{
+    int sockets[2] = {handoff_test_socket(), handoff_test_socket()};
+    struct handoff_test_taker taker = {.max_sockets = DNS_HANDOFF_MAX_SOCKETS, .reject = true};
+    CU_ASSERT_FALSE(handoff_test_run(&taker, sockets, 2));
+    CU_ASSERT_FATAL(2 == taker.count);
+    close(taker.sockets[0]);
+    close(taker.sockets[1]);
+
+    // The sockets of the running instance still receive queries.
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(handoff_test_port(sockets[0])), .sin_addr.s_addr = inet_addr("127.0.0.1")};
+    int client = socket(AF_INET, SOCK_DGRAM, 0);
+    CU_ASSERT_EQUAL(1, sendto(client, "q", 1, 0, (struct sockaddr *)&address, sizeof(address)));
+    char query;
+    CU_ASSERT_EQUAL(1, recv(sockets[0], &query, 1, 0));
+    close(client);
+    close(sockets[0]);
+    close(sockets[1]);
+}
+
+/**
+ * Test that a connection closed without the acknowledgement does not count
+ * as a completed handoff.
+ */
+void test_dns_handoff_not_ready(void)
+{
+    int pair[2];
+    CU_ASSERT_FATAL(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    close(pair[1]);
+    CU_ASSERT_FALSE(handoff_is_complete(pair[0]));
+
+    char marker = DNS_HANDOFF_SOCKETS;
+    CU_ASSERT_FATAL(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    CU_ASSERT_FATAL(write(pair[1], &marker, 1) == 1);
+    CU_ASSERT_FALSE(handoff_is_complete(pair[0]));
+    close(pair[1]);
+}
+
+/**
+ * Test that at most DNS_HANDOFF_MAX_SOCKETS sockets are sent, and that the
+ * taker keeps only as many as it has room for.
+ */
+void test_dns_handoff_truncation(void)
+{
+    int count = DNS_HANDOFF_MAX_SOCKETS + 4;
+    int sockets[DNS_HANDOFF_MAX_SOCKETS + 4];
+    for (int i = 0; i < count; i++)
+    {
+        sockets[i] = handoff_test_socket();
+    }
+
+    struct handoff_test_taker taker = {.max_sockets = DNS_HANDOFF_MAX_SOCKETS + 8};
+    CU_ASSERT_TRUE(handoff_test_run(&taker, sockets, count));
+    CU_ASSERT_FATAL(DNS_HANDOFF_MAX_SOCKETS == taker.count);
+    CU_ASSERT_EQUAL(handoff_test_port(sockets[DNS_HANDOFF_MAX_SOCKETS - 1]), handoff_test_port(taker.sockets[DNS_HANDOFF_MAX_SOCKETS - 1]));
+    for (int i = 0; i < taker.count; i++)
+    {
+        close(taker.sockets[i]);
+    }
+
+    taker = (struct handoff_test_taker){.max_sockets = 2};
+    CU_ASSERT_TRUE(handoff_test_run(&taker, sockets, 5));
+    CU_ASSERT_FATAL(2 == taker.count);
+    CU_ASSERT_EQUAL(handoff_test_port(sockets[1]), handoff_test_port(taker.sockets[1]));
+    close(taker.sockets[0]);
+    close(taker.sockets[1]);
+    for (int i = 0; i < count; i++)
+    {
+        close(sockets[i]);
+    }
+}
+
+int add_dns_handoff_test_suite(void)
+{
+    CU_pSuite handoffSuite = CU_add_suite("DNS Handoff Tests", initialize_dns_handoff_test_suite, cleanup_dns_handoff_test_suite);
+    if (NULL == handoffSuite)
+    {
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(handoffSuite, "Test of handoff_take_over without a running instance", test_dns_handoff_no_instance)) ||
+        (NULL == CU_add_test(handoffSuite, "Test of handoff_give_away and handoff_take_over functions", test_dns_handoff_sockets)) ||
+        (NULL == CU_add_test(handoffSuite, "Test of handoff_acknowledge rejecting the sockets", test_dns_handoff_rejected)) ||
+        (NULL == CU_add_test(handoffSuite, "Test of handoff_is_complete without an acknowledgement", test_dns_handoff_not_ready)) ||
+        (NULL == CU_add_test(handoffSuite, "Test of the handoff socket limits", test_dns_handoff_truncation)))
+    {
+        return CU_get_error();
+    }
+    return CUE_SUCCESS;
+}
@@ -10,6 +10,7 @@
 // Include files needed from sources.
 #include "../src/dns_defns.h"
 #include "../src/dns_manager.h"
+#include "test_suites.h"
 
 // General-purpose buffer used by tests. Used Wireshark sample DNS capture
 // https://wiki.wireshark.org/SampleCaptures and generated integer values
@@ -45,8 +46,8 @@ int cleanup_dns_manager_test_suite(void)
 void test_add_answers(void)
 {
     ssize_t message_size = sizeof(test_message);
-    char default_address_response[100] = "6.6.6.6";
-    CU_ASSERT_EQUAL(28, add_answers(test_message + DNS_HEADER_SIZE, get_dns_qdcount(test_message), message_size, default_address_response));
+    struct dns_answer_policy policy = {.address = inet_addr("6.6.6.6")};
+    CU_ASSERT_EQUAL(28, add_answers(test_message + DNS_HEADER_SIZE, get_dns_qdcount(test_message), message_size, &policy));
 }
 
 /** 
@@ -332,6 +333,25 @@ int main()
         return CU_get_error();
     }
 
+    // Add the suites implemented in the other test files.
+    if (CUE_SUCCESS != add_dns_cache_test_suite() ||
+        CUE_SUCCESS != add_dns_table_test_suite() ||
+        CUE_SUCCESS != add_dns_topk_test_suite() ||
+        CUE_SUCCESS != add_dns_overload_test_suite() ||
+        CUE_SUCCESS != add_dns_pattern_test_suite() ||
+        CUE_SUCCESS != add_dns_socket_test_suite() ||
+        CUE_SUCCESS != add_dns_batch_test_suite() ||
+        CUE_SUCCESS != add_dns_answer_test_suite() ||
+        CUE_SUCCESS != add_dns_steer_test_suite() ||
+        CUE_SUCCESS != add_dns_config_test_suite() ||
+        CUE_SUCCESS != add_dns_any_test_suite() ||
+        CUE_SUCCESS != add_dns_arena_test_suite() ||
+        CUE_SUCCESS != add_dns_handoff_test_suite())
+    {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
     // Run all of the tests.
     CU_basic_set_mode(CU_BRM_VERBOSE);
     CU_basic_run_tests();
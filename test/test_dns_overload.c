@@ -0,0 +1,117 @@
+/**
+ * Test the functions associated with the dns_overload module that sheds load
+ * when the daemon falls behind.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "CUnit/Basic.h"
+
+// Include files needed from sources.
+#include "../src/dns_defns.h"
+#include "../src/dns_manager.h"
+#include "../src/dns_overload.h"
+#include "test_suites.h"
+
+// A query for the A record of google.com with an EDNS OPT record.
+static const uint8_t overload_test_query[] = {
+    0x10, 0x32, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x01, 0x06, 0x67, 0x6f, 0x6f,
+    0x67, 0x6c, 0x65, 0x03, 0x63, 0x6f, 0x6d, 0x00,
+    0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x29, 0x10,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+/**
+ * Start the DNS overload test suite.
+ */
+int initialize_dns_overload_test_suite(void)
+{
+    fprintf(stdout, "\nStarting DNS Overload Tests.");
+    return 0;
+}
+
+/**
+ * Close down the DNS overload test suite.
+ */
+int cleanup_dns_overload_test_suite(void)
+{
+    fprintf(stdout, "\nCompleting DNS Overload Tests.");
+    return 0;
+}
+
+/**
+ * Test that a shed query gets a REFUSED reply echoing only its question, and
+ * that the drop action does not reply at all.
+ */
+void test_dns_overload_shed(void)
+{
+    struct dns_overload overload;
+    uint8_t message[DNS_UDP_MAX_SIZE];
+
+    dns_overload_init(&overload, DNS_OVERLOAD_REFUSE);
+    memcpy(message, overload_test_query, sizeof(overload_test_query));
+    CU_ASSERT_EQUAL(28, dns_overload_shed(&overload, message, sizeof(overload_test_query)));
+    CU_ASSERT_EQUAL(0x1032, get_dns_id(message));
+    CU_ASSERT_EQUAL(DNS_FLAG_QR | DNS_FLAG_RD | DNS_FLAG_RCODE_REFUSED, get_dns_flags(message));
+    CU_ASSERT_EQUAL(1, get_dns_qdcount(message));
+    CU_ASSERT_EQUAL(0, get_dns_arcount(message));
+
+    dns_overload_init(&overload, DNS_OVERLOAD_DROP);
+    memcpy(message, overload_test_query, sizeof(overload_test_query));
+    CU_ASSERT_EQUAL(0, dns_overload_shed(&overload, message, sizeof(overload_test_query)));
+    CU_ASSERT_EQUAL(1, overload.shed);
+}
+
+/**
+ * Test that high latency switches to degraded mode, and that it only returns
+ * to normal after enough calm samples of the receive backlog.
+ */
+void test_dns_overload_hysteresis(void)
+{
+    struct dns_overload overload;
+    int test_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(test_socket >= 0);
+
+    dns_overload_init(&overload, DNS_OVERLOAD_REFUSE);
+    for (int i = 0; i < 32; i++)
+    {
+        dns_overload_record_latency(&overload, 10 * DNS_OVERLOAD_HIGH_LATENCY_NS);
+    }
+    for (int i = 0; i < DNS_OVERLOAD_CHECK_INTERVAL; i++)
+    {
+        dns_overload_check(&overload, test_socket);
+    }
+    CU_ASSERT_TRUE(overload.degraded);
+
+    // The empty socket is calm, but only enough calm samples end the overload.
+    for (int i = 0; i < (DNS_OVERLOAD_CALM_CHECKS - 1) * DNS_OVERLOAD_CHECK_INTERVAL; i++)
+    {
+        dns_overload_check(&overload, test_socket);
+    }
+    CU_ASSERT_TRUE(overload.degraded);
+    for (int i = 0; i < DNS_OVERLOAD_CHECK_INTERVAL; i++)
+    {
+        dns_overload_check(&overload, test_socket);
+    }
+    CU_ASSERT_FALSE(overload.degraded);
+    CU_ASSERT_EQUAL(2, overload.transitions);
+    close(test_socket);
+}
+
+int add_dns_overload_test_suite(void)
+{
+    CU_pSuite overloadSuite = CU_add_suite("DNS Overload Tests", initialize_dns_overload_test_suite, cleanup_dns_overload_test_suite);
+    if (NULL == overloadSuite)
+    {
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(overloadSuite, "Test of dns_overload_shed function", test_dns_overload_shed)) ||
+        (NULL == CU_add_test(overloadSuite, "Test of dns_overload_check function", test_dns_overload_hysteresis)))
+    {
+        return CU_get_error();
+    }
+    return CUE_SUCCESS;
+}
@@ -0,0 +1,199 @@
+/**
+ * Test the functions associated with the dns_pattern module that matches
+ * question names against wildcard patterns.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "CUnit/Basic.h"
+
+// Include files needed from sources.
+#include "../src/dns_defns.h"
+#include "../src/dns_pattern.h"
+#include "../src/dns_table.h"
+#include "test_suites.h"
+
+// Patterns exercising every wildcard.
+static char *pattern_test_patterns[] = {
+    "ads.example.com",
+    "ad?.example.net",
+    "track*.example.com",
+    "**.doubleclick.net.",
+    "*.*.tracker.org",
+};
+
+/**
+ * Match a textual name, encoding it to the wire format first.
+ */
+static bool match_test_name(const struct dns_pattern_dfa *dfa, const char *text)
+{
+    uint8_t name[DNS_NAME_MAX_SIZE];
+    CU_ASSERT_FATAL(dns_table_encode_name(text, strlen(text), name) > 0);
+    return dns_pattern_match(dfa, name);
+}
+
+/**
+ * Start the DNS pattern test suite.
+ */
+int initialize_dns_pattern_test_suite(void)
+{
+    fprintf(stdout, "\nStarting DNS Pattern Tests.");
+    return 0;
+}
+
+/**
+ * Close down the DNS pattern test suite.
+ */
+int cleanup_dns_pattern_test_suite(void)
+{
+    fprintf(stdout, "\nCompleting DNS Pattern Tests.");
+    return 0;
+}
+
+/**
+ * Test that each wildcard matches what it should, ignoring case, and that
+ * a single star never crosses a label boundary.
+ */
+void test_dns_pattern_match(void)
+{
+    struct dns_pattern_dfa dfa;
+    struct dns_pattern_stats stats;
+    dns_pattern_compile(&dfa, pattern_test_patterns, 5, &stats);
+    CU_ASSERT_EQUAL(5, stats.patterns);
+    CU_ASSERT_TRUE(stats.minimized_states <= stats.states);
+
+    CU_ASSERT_TRUE(match_test_name(&dfa, "ads.example.com"));
+    CU_ASSERT_TRUE(match_test_name(&dfa, "ADS.Example.COM"));
+    CU_ASSERT_FALSE(match_test_name(&dfa, "ads.example.co"));
+    CU_ASSERT_FALSE(match_test_name(&dfa, "www.ads.example.com"));
+
+    CU_ASSERT_TRUE(match_test_name(&dfa, "adx.example.net"));
+    CU_ASSERT_FALSE(match_test_name(&dfa, "ad.example.net"));
+    CU_ASSERT_FALSE(match_test_name(&dfa, "adxx.example.net"));
+
+    CU_ASSERT_TRUE(match_test_name(&dfa, "track.example.com"));
+    CU_ASSERT_TRUE(match_test_name(&dfa, "tracking-pixel.example.com"));
+    CU_ASSERT_FALSE(match_test_name(&dfa, "track.me.example.com"));
+
+    CU_ASSERT_TRUE(match_test_name(&dfa, "a.b.c.doubleclick.net"));
+    CU_ASSERT_TRUE(match_test_name(&dfa, "x.doubleclick.net"));
+    CU_ASSERT_FALSE(match_test_name(&dfa, "doubleclick.net"));
+
+    CU_ASSERT_TRUE(match_test_name(&dfa, "a.b.tracker.org"));
+    CU_ASSERT_FALSE(match_test_name(&dfa, "a.tracker.org"));
+    CU_ASSERT_FALSE(match_test_name(&dfa, "a.b.c.tracker.org"));
+    dns_pattern_free(&dfa);
+}
+
+/**
+ * Test that patterns shadowed by an earlier one minimize to the DFA of that
+ * pattern alone, and that an empty pattern set never matches.
+ */
+void test_dns_pattern_minimize(void)
+{
+    struct dns_pattern_dfa single, redundant, empty;
+    struct dns_pattern_stats stats;
+    char *single_patterns[] = {"*.example.com"};
+    char *redundant_patterns[] = {"*.example.com", "WWW.example.com.", "w*.example.com"};
+
+    dns_pattern_compile(&single, single_patterns, 1, &stats);
+    dns_pattern_compile(&redundant, redundant_patterns, 3, &stats);
+    CU_ASSERT_TRUE(stats.minimized_states < stats.states);
+    CU_ASSERT_EQUAL(single.state_count, redundant.state_count);
+    CU_ASSERT_TRUE(match_test_name(&redundant, "www.example.com"));
+    CU_ASSERT_FALSE(match_test_name(&redundant, "a.b.example.com"));
+
+    dns_pattern_compile(&empty, NULL, 0, &stats);
+    CU_ASSERT_FALSE(match_test_name(&empty, "example.com"));
+    dns_pattern_free(&single);
+    dns_pattern_free(&redundant);
+    dns_pattern_free(&empty);
+}
+
+/**
+ * Test that patterns spread over several batches are all matched once the
+ * batches are joined.
+ */
+void test_dns_pattern_join(void)
+{
+    char *patterns[3 * DNS_PATTERN_BATCH_SIZE];
+    char name[64];
+    for (int i = 0; i < 3 * DNS_PATTERN_BATCH_SIZE; i++)
+    {
+        snprintf(name, sizeof(name), (i % 2) ? "site%d.**.example.com" : "*.ads%d.net", i);
+        patterns[i] = strdup(name);
+    }
+
+    struct dns_pattern_dfa dfa;
+    struct dns_pattern_stats stats;
+    dns_pattern_compile(&dfa, patterns, 3 * DNS_PATTERN_BATCH_SIZE, &stats);
+    CU_ASSERT_TRUE(match_test_name(&dfa, "www.ads0.net"));
+    CU_ASSERT_TRUE(match_test_name(&dfa, "site1.a.b.example.com"));
+    snprintf(name, sizeof(name), "x.ads%d.net", 3 * DNS_PATTERN_BATCH_SIZE - 2);
+    CU_ASSERT_TRUE(match_test_name(&dfa, name));
+    snprintf(name, sizeof(name), "site%d.www.example.com", 3 * DNS_PATTERN_BATCH_SIZE - 1);
+    CU_ASSERT_TRUE(match_test_name(&dfa, name));
+    CU_ASSERT_FALSE(match_test_name(&dfa, "www.ads1.net"));
+    CU_ASSERT_FALSE(match_test_name(&dfa, "site0.www.example.com"));
+    CU_ASSERT_FALSE(match_test_name(&dfa, "site1.example.com"));
+
+    dns_pattern_free(&dfa);
+    for (int i = 0; i < 3 * DNS_PATTERN_BATCH_SIZE; i++)
+    {
+        free(patterns[i]);
+    }
+}
+
+/**
+ * Test that a text pattern file compiles, and that a saved DFA loads back
+ * and matches the same names.
+ */
+void test_dns_pattern_load(void)
+{
+    char text_path[] = "/tmp/dns_pattern_test_XXXXXX";
+    char compiled_path[] = "/tmp/dns_pattern_test_XXXXXX";
+    int text_file = mkstemp(text_path);
+    int compiled_file = mkstemp(compiled_path);
+    CU_ASSERT_FATAL(text_file >= 0 && compiled_file >= 0);
+    const char contents[] = "# Ad servers\nads.example.com\n\n  track*.example.com  # trackers\n";
+    CU_ASSERT_FATAL(write(text_file, contents, strlen(contents)) == (ssize_t)strlen(contents));
+    close(text_file);
+    close(compiled_file);
+
+    struct dns_pattern_dfa dfa, loaded;
+    struct dns_pattern_stats stats;
+    dns_pattern_load(&dfa, text_path, &stats);
+    CU_ASSERT_EQUAL(2, stats.patterns);
+    dns_pattern_save(&dfa, compiled_path);
+    dns_pattern_load(&loaded, compiled_path, &stats);
+    CU_ASSERT_EQUAL(0, stats.patterns);
+    CU_ASSERT_EQUAL(dfa.state_count, loaded.state_count);
+    CU_ASSERT_TRUE(match_test_name(&loaded, "ads.example.com"));
+    CU_ASSERT_TRUE(match_test_name(&loaded, "TRACKER.example.com"));
+    CU_ASSERT_FALSE(match_test_name(&loaded, "example.com"));
+
+    dns_pattern_free(&dfa);
+    dns_pattern_free(&loaded);
+    unlink(text_path);
+    unlink(compiled_path);
+}
+
+int add_dns_pattern_test_suite(void)
+{
+    CU_pSuite patternSuite = CU_add_suite("DNS Pattern Tests", initialize_dns_pattern_test_suite, cleanup_dns_pattern_test_suite);
+    if (NULL == patternSuite)
+    {
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(patternSuite, "Test of dns_pattern_match function", test_dns_pattern_match)) ||
+        (NULL == CU_add_test(patternSuite, "Test of dns_pattern_compile minimization", test_dns_pattern_minimize)) ||
+        (NULL == CU_add_test(patternSuite, "Test of dns_pattern_compile joining batches", test_dns_pattern_join)) ||
+        (NULL == CU_add_test(patternSuite, "Test of dns_pattern_load and dns_pattern_save functions", test_dns_pattern_load)))
+    {
+        return CU_get_error();
+    }
+    return CUE_SUCCESS;
+}
@@ -0,0 +1,211 @@
+/**
+ * Test the functions associated with the dns_socket module that receives
+ * queries and sends replies with their packet information.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/un.h>
+#include "CUnit/Basic.h"
+
+// Include files needed from sources.
+#include "../src/dns_socket.h"
+#include "test_suites.h"
+
+/**
+ * Start the DNS socket test suite.
+ */
+int initialize_dns_socket_test_suite(void)
+{
+    fprintf(stdout, "\nStarting DNS Socket Tests.");
+    return 0;
+}
+
+/**
+ * Close down the DNS socket test suite.
+ */
+int cleanup_dns_socket_test_suite(void)
+{
+    fprintf(stdout, "\nCompleting DNS Socket Tests.");
+    return 0;
+}
+
+/**
+ * Test that a socket bound to the wildcard address learns which local address
+ * a datagram arrived on, and replies from that address.
+ */
+void test_dns_socket_pktinfo(void)
+{
+    int server = socket(AF_INET, SOCK_DGRAM, 0);
+    int client = socket(AF_INET, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(server >= 0 && client >= 0);
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_addr.s_addr = INADDR_ANY};
+    socklen_t address_size = sizeof(address);
+    CU_ASSERT_FATAL(bind(server, (struct sockaddr *)&address, sizeof(address)) == 0);
+    CU_ASSERT_FATAL(getsockname(server, (struct sockaddr *)&address, &address_size) == 0);
+    dns_socket_enable_pktinfo(server);
+
+    // Any address in 127.0.0.0/8 is local, so use one that is not the default.
+    address.sin_addr.s_addr = inet_addr("127.0.0.2");
+    CU_ASSERT_FATAL(sendto(client, "query", 5, 0, (struct sockaddr *)&address, sizeof(address)) == 5);
+
+    uint8_t buffer[16];
+    struct dns_datagram datagram;
+    struct in6_addr expected;
+    CU_ASSERT_EQUAL(5, dns_socket_receive(server, buffer, sizeof(buffer), 0, &datagram));
+    CU_ASSERT_TRUE(datagram.has_local);
+    dns_socket_map_address(inet_addr("127.0.0.2"), &expected);
+    CU_ASSERT_TRUE(IN6_ARE_ADDR_EQUAL(&expected, &datagram.local));
+
+    // The reply comes back from the address the query was sent to.
+    struct sockaddr_in source;
+    socklen_t source_size = sizeof(source);
+    CU_ASSERT_EQUAL(5, dns_socket_send(server, (const uint8_t *)"reply", 5, &datagram));
+    CU_ASSERT_EQUAL(5, recvfrom(client, buffer, sizeof(buffer), 0, (struct sockaddr *)&source, &source_size));
+    CU_ASSERT_EQUAL(inet_addr("127.0.0.2"), source.sin_addr.s_addr);
+    close(server);
+    close(client);
+}
+
+/**
+ * Test that several queued datagrams are received by a single batch call, and
+ * that a batch of replies reaches the client in order.
+ */
+void test_dns_socket_batch(void)
+{
+    int server = socket(AF_INET, SOCK_DGRAM, 0);
+    int client = socket(AF_INET, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(server >= 0 && client >= 0);
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_addr.s_addr = inet_addr("127.0.0.1")};
+    socklen_t address_size = sizeof(address);
+    CU_ASSERT_FATAL(bind(server, (struct sockaddr *)&address, sizeof(address)) == 0);
+    CU_ASSERT_FATAL(getsockname(server, (struct sockaddr *)&address, &address_size) == 0);
+    dns_socket_enable_pktinfo(server);
+    for (char query = '0'; query < '3'; query++)
+    {
+        CU_ASSERT_FATAL(sendto(client, &query, 1, 0, (struct sockaddr *)&address, sizeof(address)) == 1);
+    }
+
+    static uint8_t buffers[DNS_BATCH_SIZE][DNS_UDP_MAX_SIZE];
+    ssize_t sizes[DNS_BATCH_SIZE];
+    struct dns_datagram datagrams[DNS_BATCH_SIZE];
+    CU_ASSERT_EQUAL(3, dns_socket_receive_batch(server, buffers, sizes, datagrams, DNS_BATCH_SIZE, MSG_DONTWAIT));
+    CU_ASSERT_EQUAL(1, sizes[2]);
+    CU_ASSERT_EQUAL('2', buffers[2][0]);
+    CU_ASSERT_TRUE(datagrams[2].has_local);
+
+    uint8_t *replies[2] = {buffers[2], buffers[0]};
+    const struct dns_datagram *reply_datagrams[2] = {&datagrams[2], &datagrams[0]};
+    CU_ASSERT_EQUAL(2, dns_socket_send_batch(server, replies, sizes, reply_datagrams, 2));
+    uint8_t reply;
+    CU_ASSERT_EQUAL(1, recv(client, &reply, 1, 0));
+    CU_ASSERT_EQUAL('2', reply);
+    CU_ASSERT_EQUAL(1, recv(client, &reply, 1, 0));
+    CU_ASSERT_EQUAL('0', reply);
+    close(server);
+    close(client);
+}
+
+/**
+ * Test that a batch of replies over a Unix socket skips a peer that has gone
+ * away and still reaches the peers after it.
+ */
+void test_dns_socket_unix_batch(void)
+{
+    int server = socket(AF_UNIX, SOCK_DGRAM, 0);
+    int gone = socket(AF_UNIX, SOCK_DGRAM, 0);
+    int client = socket(AF_UNIX, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(server >= 0 && gone >= 0 && client >= 0);
+
+    // An empty address autobinds each socket to an abstract name.
+    sa_family_t autobind = AF_UNIX;
+    struct sockaddr_un address;
+    socklen_t address_size = sizeof(address);
+    CU_ASSERT_FATAL(bind(server, (struct sockaddr *)&autobind, sizeof(autobind)) == 0);
+    CU_ASSERT_FATAL(bind(gone, (struct sockaddr *)&autobind, sizeof(autobind)) == 0);
+    CU_ASSERT_FATAL(bind(client, (struct sockaddr *)&autobind, sizeof(autobind)) == 0);
+    CU_ASSERT_FATAL(getsockname(server, (struct sockaddr *)&address, &address_size) == 0);
+    CU_ASSERT_FATAL(sendto(gone, "0", 1, 0, (struct sockaddr *)&address, address_size) == 1);
+    CU_ASSERT_FATAL(sendto(client, "1", 1, 0, (struct sockaddr *)&address, address_size) == 1);
+    close(gone);
+
+    static uint8_t buffers[DNS_BATCH_SIZE][DNS_UDP_MAX_SIZE];
+    ssize_t sizes[DNS_BATCH_SIZE];
+    struct dns_datagram datagrams[DNS_BATCH_SIZE];
+    CU_ASSERT_FATAL(2 == dns_socket_receive_batch(server, buffers, sizes, datagrams, DNS_BATCH_SIZE, MSG_DONTWAIT));
+    CU_ASSERT_FALSE(datagrams[1].has_local);
+
+    uint8_t *replies[2] = {buffers[0], buffers[1]};
+    const struct dns_datagram *reply_datagrams[2] = {&datagrams[0], &datagrams[1]};
+    CU_ASSERT_EQUAL(1, dns_socket_send_batch(server, replies, sizes, reply_datagrams, 2));
+    uint8_t reply;
+    CU_ASSERT_EQUAL(1, recv(client, &reply, 1, MSG_DONTWAIT));
+    CU_ASSERT_EQUAL('1', reply);
+    close(server);
+    close(client);
+}
+
+/**
+ * Test that datagrams dropped on a full receive buffer are counted, and that
+ * the buffers are sized to hold a burst.
+ */
+void test_dns_socket_drops(void)
+{
+    int server = socket(AF_INET, SOCK_DGRAM, 0);
+    int client = socket(AF_INET, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(server >= 0 && client >= 0);
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_addr.s_addr = inet_addr("127.0.0.1")};
+    socklen_t address_size = sizeof(address);
+    CU_ASSERT_FATAL(bind(server, (struct sockaddr *)&address, sizeof(address)) == 0);
+    CU_ASSERT_FATAL(getsockname(server, (struct sockaddr *)&address, &address_size) == 0);
+    dns_socket_enable_drops(server);
+
+    // The smallest receive buffer holds only a few datagrams.
+    int small = 1;
+    CU_ASSERT_FATAL(setsockopt(server, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small)) == 0);
+    for (int i = 0; i < 64; i++)
+    {
+        sendto(client, "query", 5, 0, (struct sockaddr *)&address, sizeof(address));
+    }
+    // Datagrams carry the counter as it was when they were queued, so only
+    // one sent after the drops reports them.
+    uint8_t buffer[16];
+    struct dns_datagram datagram;
+    CU_ASSERT_EQUAL(5, dns_socket_receive(server, buffer, sizeof(buffer), 0, &datagram));
+    CU_ASSERT_FALSE(datagram.has_drops);
+    while (dns_socket_receive(server, buffer, sizeof(buffer), MSG_DONTWAIT, &datagram) == 5)
+    {
+    }
+    sendto(client, "query", 5, 0, (struct sockaddr *)&address, sizeof(address));
+    CU_ASSERT_EQUAL(5, dns_socket_receive(server, buffer, sizeof(buffer), 0, &datagram));
+    CU_ASSERT_TRUE(datagram.has_drops);
+    CU_ASSERT_TRUE(datagram.drops > 0 && datagram.drops < 64);
+
+    struct dns_socket_stats stats;
+    dns_socket_size_buffers(server, 256);
+    dns_socket_read_buffers(server, &stats);
+    CU_ASSERT_TRUE(stats.receive_buffer >= 256 * DNS_SOCKET_DATAGRAM_TRUESIZE);
+    CU_ASSERT_TRUE(stats.send_buffer >= 256 * DNS_SOCKET_DATAGRAM_TRUESIZE);
+    close(server);
+    close(client);
+}
+
+int add_dns_socket_test_suite(void)
+{
+    CU_pSuite socketSuite = CU_add_suite("DNS Socket Tests", initialize_dns_socket_test_suite, cleanup_dns_socket_test_suite);
+    if (NULL == socketSuite)
+    {
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(socketSuite, "Test of dns_socket_receive and dns_socket_send functions", test_dns_socket_pktinfo)) ||
+        (NULL == CU_add_test(socketSuite, "Test of dns_socket_receive_batch and dns_socket_send_batch functions", test_dns_socket_batch)) ||
+        (NULL == CU_add_test(socketSuite, "Test of dns_socket_send_batch over a Unix socket", test_dns_socket_unix_batch)) ||
+        (NULL == CU_add_test(socketSuite, "Test of dns_socket_enable_drops and dns_socket_size_buffers functions", test_dns_socket_drops)))
+    {
+        return CU_get_error();
+    }
+    return CUE_SUCCESS;
+}
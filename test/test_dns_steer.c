@@ -0,0 +1,128 @@
+/**
+ * Test the functions associated with the dns_steer module that steers
+ * queries across the sockets of a SO_REUSEPORT group.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "CUnit/Basic.h"
+
+// Include files needed from sources.
+#include "../src/dns_steer.h"
+#include "test_suites.h"
+
+// The sockets in the test group, and the clients and source ports per client.
+#define STEER_TEST_WORKERS 4
+#define STEER_TEST_CLIENTS 8
+#define STEER_TEST_PORTS 4
+
+/**
+ * Start the DNS steer test suite.
+ */
+int initialize_dns_steer_test_suite(void)
+{
+    fprintf(stdout, "\nStarting DNS Steer Tests.");
+    return 0;
+}
+
+/**
+ * Close down the DNS steer test suite.
+ */
+int cleanup_dns_steer_test_suite(void)
+{
+    fprintf(stdout, "\nCompleting DNS Steer Tests.");
+    return 0;
+}
+
+/**
+ * Test that steering modes are parsed and that each program fits.
+ */
+void test_dns_steer_build(void)
+{
+    struct sock_filter program[DNS_STEER_MAX_INSTRUCTIONS];
+    enum dns_steer_mode mode;
+    CU_ASSERT_TRUE(dns_steer_parse_mode("client", &mode));
+    CU_ASSERT_EQUAL(DNS_STEER_CLIENT, mode);
+    CU_ASSERT_TRUE(dns_steer_parse_mode("cpu", &mode));
+    CU_ASSERT_EQUAL(DNS_STEER_CPU, mode);
+    CU_ASSERT_TRUE(dns_steer_parse_mode("kernel", &mode));
+    CU_ASSERT_EQUAL(DNS_STEER_KERNEL, mode);
+    CU_ASSERT_FALSE(dns_steer_parse_mode("random", &mode));
+
+    size_t length = dns_steer_build(DNS_STEER_CLIENT, STEER_TEST_WORKERS, program);
+    CU_ASSERT_TRUE(length > 0 && length <= DNS_STEER_MAX_INSTRUCTIONS);
+    CU_ASSERT_EQUAL(BPF_RET | BPF_A, program[length - 1].code);
+    length = dns_steer_build(DNS_STEER_CPU, STEER_TEST_WORKERS, program);
+    CU_ASSERT_EQUAL(BPF_RET | BPF_A, program[length - 1].code);
+}
+
+/**
+ * Test that every query of a client reaches the same socket of the group,
+ * whichever source port it comes from, and that it is the socket predicted by
+ * dns_steer_client_worker().
+ */
+void test_dns_steer_client(void)
+{
+    int servers[STEER_TEST_WORKERS];
+    int enable = 1;
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_addr.s_addr = inet_addr("127.0.0.1")};
+    socklen_t address_size = sizeof(address);
+    for (int i = 0; i < STEER_TEST_WORKERS; i++)
+    {
+        servers[i] = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        CU_ASSERT_FATAL(servers[i] >= 0);
+        CU_ASSERT_FATAL(setsockopt(servers[i], SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == 0);
+        CU_ASSERT_FATAL(bind(servers[i], (struct sockaddr *)&address, sizeof(address)) == 0);
+        // The first socket picks the port the others share.
+        CU_ASSERT_FATAL(getsockname(servers[i], (struct sockaddr *)&address, &address_size) == 0);
+    }
+    dns_steer_attach(servers[0], DNS_STEER_CLIENT, STEER_TEST_WORKERS);
+
+    // Any address in 127.0.0.0/8 is local, so each client gets its own.
+    for (int client = 0; client < STEER_TEST_CLIENTS; client++)
+    {
+        for (int port = 0; port < STEER_TEST_PORTS; port++)
+        {
+            int sender = socket(AF_INET, SOCK_DGRAM, 0);
+            struct sockaddr_in source = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(0x7F000A00 + client)};
+            CU_ASSERT_FATAL(bind(sender, (struct sockaddr *)&source, sizeof(source)) == 0);
+            CU_ASSERT_EQUAL(5, sendto(sender, "query", 5, 0, (struct sockaddr *)&address, sizeof(address)));
+            close(sender);
+        }
+    }
+    usleep(10000);
+
+    int received = 0;
+    for (int i = 0; i < STEER_TEST_WORKERS; i++)
+    {
+        uint8_t buffer[16];
+        struct sockaddr_in peer;
+        socklen_t peer_size = sizeof(peer);
+        while (recvfrom(servers[i], buffer, sizeof(buffer), 0, (struct sockaddr *)&peer, &peer_size) == 5)
+        {
+            CU_ASSERT_EQUAL(i, dns_steer_client_worker((struct sockaddr *)&peer, STEER_TEST_WORKERS));
+            received++;
+            peer_size = sizeof(peer);
+        }
+        close(servers[i]);
+    }
+    CU_ASSERT_EQUAL(STEER_TEST_CLIENTS * STEER_TEST_PORTS, received);
+}
+
+int add_dns_steer_test_suite(void)
+{
+    CU_pSuite steerSuite = CU_add_suite("DNS Steer Tests", initialize_dns_steer_test_suite, cleanup_dns_steer_test_suite);
+    if (NULL == steerSuite)
+    {
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(steerSuite, "Test of dns_steer_parse_mode and dns_steer_build functions", test_dns_steer_build)) ||
+        (NULL == CU_add_test(steerSuite, "Test of dns_steer_attach and dns_steer_client_worker functions", test_dns_steer_client)))
+    {
+        return CU_get_error();
+    }
+    return CUE_SUCCESS;
+}
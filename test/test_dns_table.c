@@ -0,0 +1,140 @@
+/**
+ * Test the functions associated with the dns_table and dns_loader modules
+ * that hold and load the names the daemon answers for.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "CUnit/Basic.h"
+
+// Include files needed from sources.
+#include "../src/dns_defns.h"
+#include "../src/dns_loader.h"
+#include "../src/dns_manager.h"
+#include "../src/dns_table.h"
+#include "test_suites.h"
+
+// A query for the A record of GooGle.com, with mixed case.
+static const uint8_t table_test_query[] = {
+    0x10, 0x32, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x06, 0x47, 0x6f, 0x6f,
+    0x47, 0x6c, 0x65, 0x03, 0x63, 0x6f, 0x6d, 0x00,
+    0x00, 0x01, 0x00, 0x01};
+
+/**
+ * Start the DNS table test suite.
+ */
+int initialize_dns_table_test_suite(void)
+{
+    fprintf(stdout, "\nStarting DNS Table Tests.");
+    return 0;
+}
+
+/**
+ * Close down the DNS table test suite.
+ */
+int cleanup_dns_table_test_suite(void)
+{
+    fprintf(stdout, "\nCompleting DNS Table Tests.");
+    return 0;
+}
+
+/**
+ * Test encoding textual names into lowercase wire format, and rejecting
+ * empty labels.
+ */
+void test_dns_table_encode_name(void)
+{
+    uint8_t expected[] = {0x06, 'g', 'o', 'o', 'g', 'l', 'e', 0x03, 'c', 'o', 'm', 0x00};
+    uint8_t name[DNS_NAME_MAX_SIZE];
+    CU_ASSERT_EQUAL(sizeof(expected), dns_table_encode_name("Google.COM.", 11, name));
+    CU_ASSERT_EQUAL(0, memcmp(expected, name, sizeof(expected)));
+    CU_ASSERT_EQUAL(0, dns_table_encode_name("google..com", 11, name));
+}
+
+/**
+ * Test that inserted names are found case-insensitively from the question
+ * of a message, and that the first address inserted is kept.
+ */
+void test_dns_table_lookup(void)
+{
+    struct dns_table table;
+    uint8_t name[DNS_NAME_MAX_SIZE];
+    in_addr_t address = 0;
+
+    dns_table_init(&table, 0);
+    uint8_t name_size = dns_table_encode_name("google.com", 10, name);
+    uint32_t hash = dns_table_hash(name, name_size);
+    CU_ASSERT_TRUE(dns_table_insert(&table, name, name_size, hash, inet_addr("1.2.3.4")));
+    CU_ASSERT_FALSE(dns_table_insert(&table, name, name_size, hash, inet_addr("5.6.7.8")));
+    CU_ASSERT_TRUE(dns_table_lookup(&table, table_test_query + DNS_HEADER_SIZE, &address));
+    CU_ASSERT_EQUAL(inet_addr("1.2.3.4"), address);
+    CU_ASSERT_EQUAL(1, table.count);
+    dns_table_free(&table);
+}
+
+/**
+ * Test loading a list mixing hosts entries, plain domains, comments and an
+ * invalid name, then answering from it.
+ */
+void test_dns_load_lists(void)
+{
+    char path[] = "/tmp/dnsspoof-list-XXXXXX";
+    int descriptor = mkstemp(path);
+    CU_ASSERT_FATAL(descriptor >= 0);
+    const char *contents = "# Sample list\n"
+                           "0.0.0.0 ads.example.com tracker.example.com\n"
+                           "1.2.3.4 google.com # inline comment\n"
+                           "::1 localhost\n"
+                           "plain.example.net\n"
+                           "bad..name\n"
+                           "GOOGLE.com";
+    CU_ASSERT_EQUAL((ssize_t)strlen(contents), write(descriptor, contents, strlen(contents)));
+    close(descriptor);
+
+    struct dns_table table;
+    struct dns_load_stats stats;
+    char *paths[] = {path};
+    dns_table_init(&table, 0);
+    dns_load_lists(&table, paths, 1, 2, &stats);
+    unlink(path);
+    CU_ASSERT_EQUAL(4, stats.entries);
+    CU_ASSERT_EQUAL(1, stats.duplicates);
+    CU_ASSERT_EQUAL(1, stats.invalid);
+
+    // Listed names are answered with their own address, others are unknown.
+    struct dns_answer_policy policy = {.address = inet_addr("6.6.6.6"), .table = &table};
+    uint8_t message[DNS_UDP_MAX_SIZE];
+    memcpy(message, table_test_query, sizeof(table_test_query));
+    ssize_t response_size = parse_message(message, sizeof(table_test_query), &policy);
+    CU_ASSERT_EQUAL(sizeof(table_test_query) + 16, response_size);
+    CU_ASSERT_EQUAL(1, get_dns_ancount(message));
+    CU_ASSERT_EQUAL(inet_addr("1.2.3.4"), *(in_addr_t *)(message + response_size - sizeof(in_addr_t)));
+
+    memcpy(message, table_test_query, sizeof(table_test_query));
+    message[DNS_HEADER_SIZE + 1] = 'x';
+    response_size = parse_message(message, sizeof(table_test_query), &policy);
+    CU_ASSERT_EQUAL(sizeof(table_test_query), response_size);
+    CU_ASSERT_EQUAL(0, get_dns_ancount(message));
+    CU_ASSERT_EQUAL(DNS_FLAG_RCODE_NAME_ERROR, get_dns_flags(message) & DNS_FLAG_RCODE_MASK);
+    dns_table_free(&table);
+}
+
+int add_dns_table_test_suite(void)
+{
+    CU_pSuite tableSuite = CU_add_suite("DNS Table Tests", initialize_dns_table_test_suite, cleanup_dns_table_test_suite);
+    if (NULL == tableSuite)
+    {
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(tableSuite, "Test of dns_table_encode_name function", test_dns_table_encode_name)) ||
+        (NULL == CU_add_test(tableSuite, "Test of dns_table_lookup function", test_dns_table_lookup)) ||
+        (NULL == CU_add_test(tableSuite, "Test of dns_load_lists function", test_dns_load_lists)))
+    {
+        return CU_get_error();
+    }
+    return CUE_SUCCESS;
+}
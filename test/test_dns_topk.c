@@ -0,0 +1,146 @@
+/**
+ * Test the functions associated with the dns_topk module that tracks the
+ * heaviest hitters in bounded memory.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "CUnit/Basic.h"
+
+// Include files needed from sources.
+#include "../src/dns_defns.h"
+#include "../src/dns_topk.h"
+#include "test_suites.h"
+
+// The trackers under test, large enough that they should not live on the stack.
+static struct dns_topk test_tracker;
+static struct dns_topk merged_tracker;
+
+/**
+ * Start the DNS top-K test suite.
+ */
+int initialize_dns_topk_test_suite(void)
+{
+    fprintf(stdout, "\nStarting DNS Top-K Tests.");
+    return 0;
+}
+
+/**
+ * Close down the DNS top-K test suite.
+ */
+int cleanup_dns_topk_test_suite(void)
+{
+    fprintf(stdout, "\nCompleting DNS Top-K Tests.");
+    return 0;
+}
+
+/**
+ * Find the counter of a key in the tracker.
+ */
+static const struct dns_topk_counter *tracked_counter(const struct dns_topk *tracker, const uint8_t *key, uint8_t key_size)
+{
+    for (int16_t counter = 0; counter < tracker->used; counter++)
+    {
+        if (tracker->counters[counter].key_size == key_size && memcmp(tracker->counters[counter].key, key, key_size) == 0)
+        {
+            return &tracker->counters[counter];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Find the count of a key in the tracker.
+ */
+static uint64_t tracked_count(const struct dns_topk *tracker, const uint8_t *key, uint8_t key_size)
+{
+    const struct dns_topk_counter *counter = tracked_counter(tracker, key, key_size);
+    return counter ? counter->count : 0;
+}
+
+/**
+ * Test that heavy keys keep exact counts while many more distinct light keys
+ * than there are counters pass through the tracker.
+ */
+void test_dns_topk_heavy_hitters(void)
+{
+    uint8_t heavy[] = {'h', 'e', 'a', 'v', 'y'};
+    uint8_t light[sizeof(uint32_t)];
+
+    dns_topk_init(&test_tracker, DNS_TOPK_NAMES);
+    for (uint32_t i = 0; i < 10000; i++)
+    {
+        dns_topk_add(&test_tracker, heavy, sizeof(heavy), 1);
+        memcpy(light, &i, sizeof(light));
+        dns_topk_add(&test_tracker, light, sizeof(light), 1);
+    }
+    CU_ASSERT_EQUAL(DNS_TOPK_COUNTERS, test_tracker.used);
+    CU_ASSERT_EQUAL(20000, test_tracker.total);
+    CU_ASSERT_EQUAL(10000, tracked_count(&test_tracker, heavy, sizeof(heavy)));
+
+    // The buckets stay sorted by ascending count.
+    for (int16_t bucket = test_tracker.smallest; test_tracker.buckets[bucket].next >= 0; bucket = test_tracker.buckets[bucket].next)
+    {
+        CU_ASSERT_TRUE(test_tracker.buckets[bucket].count < test_tracker.buckets[test_tracker.buckets[bucket].next].count);
+    }
+}
+
+/**
+ * Test that merging sums the counts of keys present in both trackers, and
+ * keeps the error bound of the merged counts.
+ */
+void test_dns_topk_merge(void)
+{
+    uint8_t heavy[] = {'h', 'e', 'a', 'v', 'y'};
+    uint8_t light[sizeof(uint32_t)];
+    uint32_t last = 9999;
+    memcpy(light, &last, sizeof(light));
+    const struct dns_topk_counter *source = tracked_counter(&test_tracker, light, sizeof(light));
+    CU_ASSERT_FATAL(source != NULL && source->error > 0);
+
+    dns_topk_init(&merged_tracker, DNS_TOPK_NAMES);
+    dns_topk_add(&merged_tracker, heavy, sizeof(heavy), 5);
+    dns_topk_add(&merged_tracker, light, sizeof(light), 1);
+    dns_topk_merge(&merged_tracker, &test_tracker);
+    CU_ASSERT_EQUAL(10005, tracked_count(&merged_tracker, heavy, sizeof(heavy)));
+    CU_ASSERT_EQUAL(20006, merged_tracker.total);
+
+    const struct dns_topk_counter *merged = tracked_counter(&merged_tracker, light, sizeof(light));
+    CU_ASSERT_FATAL(merged != NULL);
+    CU_ASSERT_EQUAL(source->count + 1, merged->count);
+    CU_ASSERT_EQUAL(source->error, merged->error);
+}
+
+/**
+ * Test that question names are counted case-insensitively.
+ */
+void test_dns_topk_add_name(void)
+{
+    uint8_t upper[] = {0x03, 'F', 'O', 'O', 0x03, 'c', 'o', 'm', 0x00};
+    uint8_t lower[] = {0x03, 'f', 'o', 'o', 0x03, 'c', 'o', 'm', 0x00};
+    dns_topk_init(&test_tracker, DNS_TOPK_NAMES);
+    dns_topk_add_name(&test_tracker, upper, upper + sizeof(upper));
+    dns_topk_add_name(&test_tracker, lower, lower + sizeof(lower));
+    CU_ASSERT_EQUAL(2, tracked_count(&test_tracker, lower, sizeof(lower)));
+
+    // A name running past the end of the message is ignored.
+    dns_topk_add_name(&test_tracker, lower, lower + 4);
+    CU_ASSERT_EQUAL(2, test_tracker.total);
+}
+
+int add_dns_topk_test_suite(void)
+{
+    CU_pSuite topkSuite = CU_add_suite("DNS Top-K Tests", initialize_dns_topk_test_suite, cleanup_dns_topk_test_suite);
+    if (NULL == topkSuite)
+    {
+        return CU_get_error();
+    }
+
+    if ((NULL == CU_add_test(topkSuite, "Test of dns_topk_add function", test_dns_topk_heavy_hitters)) ||
+        (NULL == CU_add_test(topkSuite, "Test of dns_topk_merge function", test_dns_topk_merge)) ||
+        (NULL == CU_add_test(topkSuite, "Test of dns_topk_add_name function", test_dns_topk_add_name)))
+    {
+        return CU_get_error();
+    }
+    return CUE_SUCCESS;
+}
@@ -0,0 +1,86 @@
+/**
+ * Declares the test suites implemented in separate test files so that the
+ * main test runner can register them.
+ */
+#ifndef TEST_SUITES_H
+#define TEST_SUITES_H
+
+/**
+ * Add the DNS cache test suite to the registry.
+ * Returns CUE_SUCCESS if the suite was added, and a CUnit error code otherwise.
+ */
+int add_dns_cache_test_suite(void);
+
+/**
+ * Add the DNS table and list loader test suite to the registry.
+ * Returns CUE_SUCCESS if the suite was added, and a CUnit error code otherwise.
+ */
+int add_dns_table_test_suite(void);
+
+/**
+ * Add the DNS top-K test suite to the registry.
+ * Returns CUE_SUCCESS if the suite was added, and a CUnit error code otherwise.
+ */
+int add_dns_topk_test_suite(void);
+
+/**
+ * Add the DNS overload test suite to the registry.
+ * Returns CUE_SUCCESS if the suite was added, and a CUnit error code otherwise.
+ */
+int add_dns_overload_test_suite(void);
+
+/**
+ * Add the DNS pattern test suite to the registry.
+ * Returns CUE_SUCCESS if the suite was added, and a CUnit error code otherwise.
+ */
+int add_dns_pattern_test_suite(void);
+
+/**
+ * Add the DNS socket test suite to the registry.
+ * Returns CUE_SUCCESS if the suite was added, and a CUnit error code otherwise.
+ */
+int add_dns_socket_test_suite(void);
+
+/**
+ * Add the DNS batch test suite to the registry.
+ * Returns CUE_SUCCESS if the suite was added, and a CUnit error code otherwise.
+ */
+int add_dns_batch_test_suite(void);
+
+/**
+ * Add the DNS answer test suite to the registry.
+ * Returns CUE_SUCCESS if the suite was added, and a CUnit error code otherwise.
+ */
+int add_dns_answer_test_suite(void);
+
+/**
+ * Add the DNS steer test suite to the registry.
+ * Returns CUE_SUCCESS if the suite was added, and a CUnit error code otherwise.
+ */
+int add_dns_steer_test_suite(void);
+
+/**
+ * Add the DNS config test suite to the registry.
+ * Returns CUE_SUCCESS if the suite was added, and a CUnit error code otherwise.
+ */
+int add_dns_config_test_suite(void);
+
+/**
+ * Add the DNS any test suite to the registry.
+ * Returns CUE_SUCCESS if the suite was added, and a CUnit error code otherwise.
+ */
+int add_dns_any_test_suite(void);
+
+/**
+ * Add the DNS arena test suite to the registry.
+ * Returns CUE_SUCCESS if the suite was added, and a CUnit error code otherwise.
+ */
+int add_dns_arena_test_suite(void);
+
+/**
+ * Add the DNS handoff test suite to the registry.
+ * Returns CUE_SUCCESS if the suite was added, and a CUnit error code otherwise.
+ */
+int add_dns_handoff_test_suite(void);
+
+#endif // TEST_SUITES_H
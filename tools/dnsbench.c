@@ -0,0 +1,237 @@
+/**
+ * Load generator for the DNS spoofing daemon. Simulates clients that each
+ * query their own set of names from a pool of source ports, the way stub
+ * resolvers pick a fresh port per query, and reports the throughput and the
+ * share of queries answered.
+ *
+ * Each client sends from its own loopback address (127.0.X.Y, any address in
+ * 127.0.0.0/8 is local), so steering by client address can be compared with
+ * the kernel's default steering:
+ *     ./dnsspoof -p 5300 -n 0 -w 4 -s client &
+ *     ./dnsbench -p 5300 -c 16 -d 48 -q 200000
+ *     kill -USR1 %1  # Per-worker cache hit rates.
+ *
+ * With -u the clients query a Unix datagram socket instead, each from its own
+ * autobound socket, so the cost of a query over the Unix socket can be
+ * compared with the same load over loopback UDP:
+ *     ./dnsspoof -p 5300 -u /tmp/dnsspoof.sock -n 0 &
+ *     ./dnsbench -p 5300 -c 4 -r 4 -q 200000
+ *     ./dnsbench -u /tmp/dnsspoof.sock -c 4 -r 4 -q 200000
+ */
+
+#include <err.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// The maximum number of clients, and of source ports of each client.
+#define DNSBENCH_MAX_CLIENTS 256
+#define DNSBENCH_MAX_PORTS 16
+
+// How long to wait for a reply before counting the query as lost.
+#define DNSBENCH_TIMEOUT_MS 100
+
+/**
+ * Display the options of the benchmark and exit.
+ */
+static void display_help_message(void)
+{
+    fprintf(stderr, "Usage: dnsbench [-s SERVER] [-p PORT] [-u PATH] [-c CLIENTS] [-r PORTS] [-d NAMES] [-q QUERIES] [-o OUTSTANDING]\n");
+    fprintf(stderr, "Each of CLIENTS addresses queries NAMES names of its own from PORTS source ports, with OUTSTANDING queries in flight per port.\n");
+    fprintf(stderr, "With -u, queries go to the Unix datagram socket at PATH instead, from CLIENTS times PORTS sockets.\n");
+    exit(1);
+}
+
+/**
+ * Write a query for the A record of name NAME_INDEX of client CLIENT_INDEX.
+ *
+ * query  : The buffer to write the query to.
+ * id     : The ID of the query.
+ * client : The index of the client.
+ * name   : The index of the name.
+ * returns : The size of the query.
+ */
+static size_t write_query(uint8_t *query, uint16_t id, int client, int name)
+{
+    char label[32];
+    size_t size = 0;
+    uint16_t header[6] = {htons(id), htons(0x0100), htons(1), 0, 0, 0};
+    memcpy(query, header, sizeof(header));
+    size += sizeof(header);
+
+    int label_size = snprintf(label, sizeof(label), "n%d-c%d", name, client);
+    query[size++] = label_size;
+    memcpy(query + size, label, label_size);
+    size += label_size;
+    memcpy(query + size, "\5bench\0\0\1\0\1", 11);
+    return size + 11;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *server = "127.0.0.1";
+    const char *path = NULL;
+    int port = 12345;
+    int client_count = 16;
+    int port_count = 8;
+    int name_count = 48;
+    long query_count = 100000;
+    int outstanding = 4;
+
+    int current;
+    while ((current = getopt(argc, argv, "s:p:u:c:r:d:q:o:h")) != -1)
+    {
+        switch (current)
+        {
+        case 's':
+            server = optarg;
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'u':
+            path = optarg;
+            break;
+        case 'c':
+            client_count = atoi(optarg);
+            break;
+        case 'r':
+            port_count = atoi(optarg);
+            break;
+        case 'd':
+            name_count = atoi(optarg);
+            break;
+        case 'q':
+            query_count = atol(optarg);
+            break;
+        case 'o':
+            outstanding = atoi(optarg);
+            break;
+        default:
+            display_help_message();
+        }
+    }
+    if (client_count < 1 || client_count > DNSBENCH_MAX_CLIENTS || port_count < 1 || port_count > DNSBENCH_MAX_PORTS ||
+        name_count < 1 || outstanding < 1 || query_count < 1)
+    {
+        display_help_message();
+    }
+
+    struct sockaddr_storage destination_storage = {0};
+    struct sockaddr *destination = (struct sockaddr *)&destination_storage;
+    socklen_t destination_size;
+    if (path)
+    {
+        struct sockaddr_un *unix_destination = (struct sockaddr_un *)destination;
+        unix_destination->sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(unix_destination->sun_path))
+        {
+            errx(1, "Socket path too long.");
+        }
+        strcpy(unix_destination->sun_path, path);
+        destination_size = sizeof(*unix_destination);
+    }
+    else
+    {
+        struct sockaddr_in *inet_destination = (struct sockaddr_in *)destination;
+        inet_destination->sin_family = AF_INET;
+        inet_destination->sin_port = htons(port);
+        if (inet_pton(AF_INET, server, &inet_destination->sin_addr) != 1)
+        {
+            errx(1, "Server address invalid.");
+        }
+        destination_size = sizeof(*inet_destination);
+    }
+
+    // One socket per source port of each client. Unix sockets are autobound
+    // to an abstract address the replies come back to, and block when the
+    // server's queue (net.unix.max_dgram_qlen) is full instead of failing.
+    int socket_count = client_count * port_count;
+    struct pollfd *sockets = calloc(socket_count, sizeof(*sockets));
+    if (sockets == NULL)
+    {
+        err(1, "calloc");
+    }
+    for (int i = 0; i < socket_count; i++)
+    {
+        int client = i / port_count;
+        struct sockaddr_in source = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(0x7F000100 + client + 1)};
+        sa_family_t unix_source = AF_UNIX;
+        sockets[i].fd = path ? socket(AF_UNIX, SOCK_DGRAM, 0) : socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        sockets[i].events = POLLIN;
+        if (sockets[i].fd < 0 ||
+            (path ? bind(sockets[i].fd, (struct sockaddr *)&unix_source, sizeof(unix_source)) : bind(sockets[i].fd, (struct sockaddr *)&source, sizeof(source))))
+        {
+            err(1, "socket");
+        }
+    }
+
+    // Keep the same number of queries in flight on every socket, sending a
+    // new one for each reply, and count whatever is left as lost.
+    long sent = 0;
+    long answered = 0;
+    long lost = 0;
+    uint8_t query[64];
+    uint8_t reply[512];
+    struct timespec start_time, end_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    for (int i = 0; i < socket_count && sent < query_count; i++)
+    {
+        for (int j = 0; j < outstanding && sent < query_count; j++, sent++)
+        {
+            size_t size = write_query(query, sent, i / port_count, random() % name_count);
+            if (sendto(sockets[i].fd, query, size, 0, destination, destination_size) < 0)
+            {
+                lost++;
+            }
+        }
+    }
+    while (answered + lost < sent)
+    {
+        int ready = poll(sockets, socket_count, DNSBENCH_TIMEOUT_MS);
+        if (ready <= 0)
+        {
+            lost = sent - answered;
+            break;
+        }
+        for (int i = 0; i < socket_count; i++)
+        {
+            if (!(sockets[i].revents & POLLIN))
+            {
+                continue;
+            }
+            while (recv(sockets[i].fd, reply, sizeof(reply), MSG_DONTWAIT) > 0)
+            {
+                answered++;
+                if (sent < query_count)
+                {
+                    size_t size = write_query(query, sent, i / port_count, random() % name_count);
+                    if (sendto(sockets[i].fd, query, size, 0, destination, destination_size) < 0)
+                    {
+                        lost++;
+                    }
+                    sent++;
+                }
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+
+    double seconds = (end_time.tv_sec - start_time.tv_sec) + (end_time.tv_nsec - start_time.tv_nsec) / 1e9;
+    printf("queries=%ld answered=%ld lost=%ld seconds=%.3f qps=%.0f\n", sent, answered, lost, seconds, answered / seconds);
+    for (int i = 0; i < socket_count; i++)
+    {
+        close(sockets[i].fd);
+    }
+    free(sockets);
+    return 0;
+}
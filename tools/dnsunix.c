@@ -0,0 +1,143 @@
+/**
+ * Client shim for the Unix datagram listener of the DNS spoofing daemon.
+ * Sends a single query over the Unix socket and prints the reply, the way
+ * dig would over UDP:
+ *     ./dnsspoof -u /tmp/dnsspoof.sock -n 0 &
+ *     ./dnsunix /tmp/dnsspoof.sock foo.com
+ *     ./dnsunix -t 255 /tmp/dnsspoof.sock foo.com
+ */
+
+#include <err.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// How long to wait for the reply.
+#define DNSUNIX_TIMEOUT_MS 1000
+
+/**
+ * Display the options of the shim and exit.
+ */
+static void display_help_message(void)
+{
+    fprintf(stderr, "Usage: dnsunix [-t TYPE] PATH NAME\n");
+    fprintf(stderr, "Queries the daemon listening on the Unix socket at PATH for the records of type TYPE (1, A, by default) of NAME.\n");
+    exit(1);
+}
+
+/**
+ * Write a query for the records of a name, split into labels.
+ *
+ * query   : The buffer to write the query to, at least 512 bytes.
+ * name    : The dotted name.
+ * type    : The record type.
+ * returns : The size of the query.
+ */
+static size_t write_query(uint8_t *query, const char *name, uint16_t type)
+{
+    size_t size = 0;
+    uint16_t header[6] = {htons(getpid() & 0xFFFF), htons(0x0100), htons(1), 0, 0, 0};
+    memcpy(query, header, sizeof(header));
+    size += sizeof(header);
+
+    while (*name)
+    {
+        size_t label_size = strcspn(name, ".");
+        if (label_size == 0 || label_size > 63 || size + label_size + 6 > 255)
+        {
+            errx(1, "Name invalid.");
+        }
+        query[size++] = label_size;
+        memcpy(query + size, name, label_size);
+        size += label_size;
+        name += label_size;
+        name += *name == '.';
+    }
+    query[size++] = 0;
+    uint16_t question[2] = {htons(type), htons(1)};
+    memcpy(query + size, question, sizeof(question));
+    return size + sizeof(question);
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t type = 1;
+    int current;
+    while ((current = getopt(argc, argv, "t:h")) != -1)
+    {
+        switch (current)
+        {
+        case 't':
+            type = atoi(optarg);
+            break;
+        default:
+            display_help_message();
+        }
+    }
+    if (argc - optind != 2)
+    {
+        display_help_message();
+    }
+
+    struct sockaddr_un destination = {.sun_family = AF_UNIX};
+    if (strlen(argv[optind]) >= sizeof(destination.sun_path))
+    {
+        errx(1, "Socket path too long.");
+    }
+    strcpy(destination.sun_path, argv[optind]);
+
+    // The daemon replies to the address the query came from, so the socket
+    // is autobound to an abstract address first.
+    sa_family_t source = AF_UNIX;
+    int client = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (client < 0 || bind(client, (struct sockaddr *)&source, sizeof(source)))
+    {
+        err(1, "socket");
+    }
+
+    uint8_t message[512];
+    size_t size = write_query(message, argv[optind + 1], type);
+    if (sendto(client, message, size, 0, (struct sockaddr *)&destination, sizeof(destination)) < 0)
+    {
+        err(1, "sendto %s", destination.sun_path);
+    }
+    struct pollfd reply_fd = {.fd = client, .events = POLLIN};
+    if (poll(&reply_fd, 1, DNSUNIX_TIMEOUT_MS) != 1)
+    {
+        errx(1, "No reply.");
+    }
+    ssize_t reply_size = recv(client, message, sizeof(message), 0);
+    if (reply_size < 12)
+    {
+        errx(1, "Reply invalid.");
+    }
+
+    uint16_t header[6];
+    memcpy(header, message, sizeof(header));
+    uint16_t flags = ntohs(header[1]);
+    printf("size=%zd flags=0x%04x rcode=%d truncated=%d answers=%d\n", reply_size, flags, flags & 0xF, (flags >> 9) & 1, ntohs(header[3]));
+
+    // Print the A records, which follow the echoed question.
+    size_t position = size;
+    for (int i = 0; i < ntohs(header[3]) && position + 12 <= (size_t)reply_size; i++)
+    {
+        uint16_t record[6];
+        memcpy(record, message + position, sizeof(record));
+        uint16_t data_size = ntohs(record[5]);
+        if (ntohs(record[1]) == 1 && data_size == 4 && position + 16 <= (size_t)reply_size)
+        {
+            char address[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, message + position + 12, address, sizeof(address));
+            printf("A %s\n", address);
+        }
+        position += 12 + data_size;
+    }
+    close(client);
+    return 0;
+}